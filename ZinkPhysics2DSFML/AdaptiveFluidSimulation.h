@@ -0,0 +1,722 @@
+#ifndef ADAPTIVE_FLUID_SIMULATION_H
+#define ADAPTIVE_FLUID_SIMULATION_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <SFML/System/Clock.hpp>
+#include "JobSystem.h"
+#include "RenderSnapshot.h"
+#include "FluidSimulation.h"
+
+// Stable Fluids on a graded quadtree. Leaves are square cells from size 1 (the finest
+// level) up to the whole domain; cells are split where density jumps between neighbors
+// and along obstacle boundaries, and merged back where four siblings agree. Velocity is
+// not a criterion: away from the interface it is carried at whatever resolution the
+// density needs, which is where the savings come from.
+// Neighboring leaves differ by at most one level (2:1 balance), so a leaf side touches
+// either one neighbor or two half-size ones.
+//
+// All quantities live at leaf centers, like FluidSimulation's collocated grid. Advection
+// backtraces each center and interpolates between the leaf containing the departure
+// point and its neighbors. The pressure solve is a finite-volume Poisson problem over the
+// leaves (flux = face length / center distance, symmetric across levels) solved with
+// incomplete-factorization preconditioned CG; walls and obstacles are closed faces.
+class AdaptiveFluidSimulation {
+public:
+    int minLevel = 3;
+    float interfaceTolerance = 0.05f; // density jump to a neighbor that forces a split
+    float coarsenTolerance = 0.01f;   // density spread below which four siblings merge
+    float gravity = 9.8f;
+    int maxIterations = 200;
+    float tolerance = 1e-4f;
+
+    // gridSize is the finest resolution per side, rounded up to a power of two.
+    explicit AdaptiveFluidSimulation(int gridSize) {
+        N = 1;
+        maxLevel = 0;
+        while (N < gridSize) {
+            N *= 2;
+            maxLevel++;
+        }
+        nodes.push_back(Node{ 0, 0, N, 0, -1, -1 });
+        resizeData();
+        refineUniform(0, std::min(minLevel, maxLevel));
+        rebuild();
+    }
+
+    void addObstacle(float centerX, float centerY, float radius) {
+        obstacles.push_back(Obstacle{ centerX, centerY, radius });
+        adapt();
+    }
+
+    // Sets density in a rectangle. Leaves straddling its edges are split down to the
+    // finest level first so the filled region matches the rectangle exactly.
+    void fillRect(int x0, int y0, int x1, int y1, float amount) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            std::vector<int> current = leaves;
+            for (int leaf : current) {
+                const Node& node = nodes[leaf];
+                bool overlaps = node.x < x1 && node.x + node.size > x0 && node.y < y1 && node.y + node.size > y0;
+                bool contained = node.x >= x0 && node.x + node.size <= x1 && node.y >= y0 && node.y + node.size <= y1;
+                if (overlaps && !contained && node.level < maxLevel) {
+                    split(leaf);
+                    changed = true;
+                }
+            }
+            rebuild();
+        }
+        for (int leaf : leaves) {
+            const Node& node = nodes[leaf];
+            float cx = node.x + 0.5f * node.size;
+            float cy = node.y + 0.5f * node.size;
+            if (cx >= x0 && cx < x1 && cy >= y0 && cy < y1) {
+                density[leaf] = amount;
+            }
+        }
+        adapt();
+    }
+
+    void update(float timestep) {
+        sf::Clock clock;
+
+        applyGravity(timestep);
+        project();
+
+        uPrev = u;
+        vPrev = v;
+        advect(u, uPrev, timestep);
+        advect(v, vPrev, timestep);
+        project();
+
+        densityPrev = density;
+        advect(density, densityPrev, timestep);
+
+        adapt();
+
+        series[FluidSimulation::StepTime].add(clock.getElapsedTime().asSeconds());
+        for (int channel = 0; channel < FluidSimulation::ChannelCount; ++channel) {
+            stepTelemetry[channel] = series[channel].commit();
+        }
+    }
+
+    // Rasterizes the leaves to the finest resolution for FluidRenderer.
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        size_t cells = static_cast<size_t>(N) * N;
+        snapshot.fluidSize = N;
+        snapshot.density.resize(cells);
+        snapshot.u.resize(cells);
+        snapshot.v.resize(cells);
+        snapshot.solid.resize(cells);
+        for (size_t l = 0; l < leaves.size(); l++) {
+            int leaf = leaves[l];
+            const Node& node = nodes[leaf];
+            for (int j = node.y; j < node.y + node.size; j++) {
+                size_t row = static_cast<size_t>(j) * N;
+                std::fill(&snapshot.density[row + node.x], &snapshot.density[row + node.x] + node.size, density[leaf]);
+                std::fill(&snapshot.u[row + node.x], &snapshot.u[row + node.x] + node.size, u[leaf]);
+                std::fill(&snapshot.v[row + node.x], &snapshot.v[row + node.x] + node.size, v[leaf]);
+                std::fill(&snapshot.solid[row + node.x], &snapshot.solid[row + node.x] + node.size, solid[l]);
+            }
+        }
+        snapshot.telemetry.assign(stepTelemetry, stepTelemetry + FluidSimulation::ChannelCount);
+    }
+
+    int getLeafCount() const {
+        return int(leaves.size());
+    }
+
+    int getResolution() const {
+        return N;
+    }
+
+private:
+    struct Node {
+        int x, y, size;
+        int level;
+        int parent;
+        int children; // first of four consecutive nodes, -1 for a leaf
+    };
+
+    struct Obstacle {
+        float x, y, radius;
+    };
+
+    // One side (or half side) of a leaf. other is a leaf index, -1 for a closed face.
+    struct Face {
+        int other;
+        float length;
+        float coefficient;
+        float normalX, normalY;
+    };
+
+    // Open faces only, as (leaf, coefficient): the matrix rows for the pressure solve.
+    struct Link {
+        int other;
+        float coefficient;
+    };
+
+    int N = 1;
+    int maxLevel = 0;
+    std::vector<Node> nodes;
+    std::vector<int> freeBlocks;
+    std::vector<Obstacle> obstacles;
+
+    // Per node; only the leaves' entries are live.
+    std::vector<float> u, v, density, pressure;
+    std::vector<float> uPrev, vPrev, densityPrev;
+
+    // Per leaf, rebuilt whenever the tree changes.
+    std::vector<int> leaves;
+    std::vector<int> leafOf;
+    std::vector<uint8_t> solid;
+    std::vector<int> faceStart;
+    std::vector<Face> faces;
+    std::vector<int> linkStart, linkSplit;
+    std::vector<Link> links;
+    std::vector<float> rhs, r, z, s, product, solution, diagonal, inverseFactor;
+
+    TelemetrySeries series[FluidSimulation::ChannelCount];
+    TelemetrySample stepTelemetry[FluidSimulation::ChannelCount];
+
+    void resizeData() {
+        size_t count = nodes.size();
+        u.resize(count, 0.0f);
+        v.resize(count, 0.0f);
+        density.resize(count, 0.0f);
+        pressure.resize(count, 0.0f);
+    }
+
+    void split(int node) {
+        int first;
+        if (!freeBlocks.empty()) {
+            first = freeBlocks.back();
+            freeBlocks.pop_back();
+        }
+        else {
+            first = int(nodes.size());
+            nodes.resize(nodes.size() + 4);
+            resizeData();
+        }
+
+        Node parent = nodes[node];
+        int half = parent.size / 2;
+        for (int k = 0; k < 4; k++) {
+            int child = first + k;
+            nodes[child] = Node{ parent.x + (k & 1) * half, parent.y + (k >> 1) * half, half, parent.level + 1, node, -1 };
+            u[child] = u[node];
+            v[child] = v[node];
+            density[child] = density[node];
+            pressure[child] = pressure[node];
+        }
+        nodes[node].children = first;
+    }
+
+    // Averaging conserves density and momentum.
+    void merge(int node) {
+        int first = nodes[node].children;
+        u[node] = v[node] = density[node] = pressure[node] = 0.0f;
+        for (int k = 0; k < 4; k++) {
+            u[node] += 0.25f * u[first + k];
+            v[node] += 0.25f * v[first + k];
+            density[node] += 0.25f * density[first + k];
+            pressure[node] += 0.25f * pressure[first + k];
+        }
+        nodes[node].children = -1;
+        freeBlocks.push_back(first);
+    }
+
+    void refineUniform(int node, int level) {
+        if (nodes[node].level >= level) {
+            return;
+        }
+        if (nodes[node].children < 0) {
+            split(node);
+        }
+        int first = nodes[node].children;
+        for (int k = 0; k < 4; k++) {
+            refineUniform(first + k, level);
+        }
+    }
+
+    // Leaf containing (x, y). Lookups start from a nearby node and climb only as far as
+    // needed, so neighbor queries rarely go back to the root.
+    int locate(float x, float y, int from = 0) const {
+        x = std::min(std::max(x, 0.0f), N - 0.001f);
+        y = std::min(std::max(y, 0.0f), N - 0.001f);
+        int node = from;
+        while (node > 0) {
+            const Node& n = nodes[node];
+            if (x >= n.x && x < n.x + n.size && y >= n.y && y < n.y + n.size) {
+                break;
+            }
+            node = n.parent;
+        }
+        while (nodes[node].children >= 0) {
+            const Node& n = nodes[node];
+            float half = 0.5f * n.size;
+            node = n.children + (x >= n.x + half ? 1 : 0) + (y >= n.y + half ? 2 : 0);
+        }
+        return node;
+    }
+
+    bool inside(float x, float y) const {
+        return x >= 0.0f && y >= 0.0f && x < N && y < N;
+    }
+
+    bool isSolidPoint(float x, float y) const {
+        for (const Obstacle& obstacle : obstacles) {
+            float dx = x - obstacle.x;
+            float dy = y - obstacle.y;
+            if (dx * dx + dy * dy <= obstacle.radius * obstacle.radius) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // True when an obstacle's outline passes within one cell size of the node.
+    bool nearObstacleEdge(const Node& node) const {
+        float cx = node.x + 0.5f * node.size;
+        float cy = node.y + 0.5f * node.size;
+        for (const Obstacle& obstacle : obstacles) {
+            float distance = std::sqrt((cx - obstacle.x) * (cx - obstacle.x) + (cy - obstacle.y) * (cy - obstacle.y));
+            if (std::fabs(distance - obstacle.radius) <= float(node.size)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void collectLeaves(int node) {
+        if (nodes[node].children < 0) {
+            leafOf[node] = int(leaves.size());
+            leaves.push_back(node);
+            return;
+        }
+        for (int k = 0; k < 4; k++) {
+            collectLeaves(nodes[node].children + k);
+        }
+    }
+
+    // The leaves across one side of a node (0 left, 1 right, 2 bottom, 3 top): none at a
+    // wall, one at least as large, or two half-size ones. Under 2:1 balance the samples at
+    // the quarter marks find both halves; on an unbalanced side at least one of them lands
+    // in a leaf smaller than half the node, which is what the balance check looks for.
+    int sideNeighbors(int from, int side, int neighbors[2]) const {
+        const Node& node = nodes[from];
+        float size = float(node.size);
+        float across = side == 0 ? node.x - 0.5f : side == 1 ? node.x + size + 0.5f : side == 2 ? node.y - 0.5f : node.y + size + 0.5f;
+        if (across < 0.0f || across >= float(N)) {
+            return 0;
+        }
+        float start = float(side < 2 ? node.y : node.x);
+        float offsets[2] = { 0.25f * size, 0.75f * size };
+        int samples = 2;
+        if (node.size == 1) {
+            offsets[0] = 0.5f;
+            samples = 1;
+        }
+        int count = 0;
+        for (int k = 0; k < samples; k++) {
+            float along = start + offsets[k];
+            int leaf = side < 2 ? locate(across, along, from) : locate(along, across, from);
+            if (count == 0 || neighbors[count - 1] != leaf) {
+                neighbors[count++] = leaf;
+            }
+        }
+        return count;
+    }
+
+    static float sideNormalX(int side) {
+        return side == 0 ? -1.0f : side == 1 ? 1.0f : 0.0f;
+    }
+
+    static float sideNormalY(int side) {
+        return side == 2 ? -1.0f : side == 3 ? 1.0f : 0.0f;
+    }
+
+    void rebuild() {
+        leaves.clear();
+        leafOf.assign(nodes.size(), -1);
+        collectLeaves(0);
+
+        size_t count = leaves.size();
+        solid.assign(count, 0);
+        for (size_t l = 0; l < count; l++) {
+            const Node& node = nodes[leaves[l]];
+            solid[l] = isSolidPoint(node.x + 0.5f * node.size, node.y + 0.5f * node.size) ? 1 : 0;
+        }
+
+        faceStart.assign(count + 1, 0);
+        faces.clear();
+        for (size_t l = 0; l < count; l++) {
+            const Node& node = nodes[leaves[l]];
+            for (int side = 0; side < 4; side++) {
+                int neighbors[2];
+                int found = sideNeighbors(leaves[l], side, neighbors);
+                if (found == 0) {
+                    faces.push_back(Face{ -1, float(node.size), 0.0f, sideNormalX(side), sideNormalY(side) });
+                }
+                for (int k = 0; k < found; k++) {
+                    const Node& neighbor = nodes[neighbors[k]];
+                    int other = leafOf[neighbors[k]];
+                    Face face{ -1, float(std::min(node.size, neighbor.size)), 0.0f, sideNormalX(side), sideNormalY(side) };
+                    if (!solid[l] && !solid[other]) {
+                        face.other = other;
+                        face.coefficient = face.length / (0.5f * (node.size + neighbor.size));
+                    }
+                    faces.push_back(face);
+                }
+            }
+            faceStart[l + 1] = int(faces.size());
+        }
+
+        rhs.assign(count, 0.0f);
+        r.assign(count, 0.0f);
+        z.assign(count, 0.0f);
+        s.assign(count, 0.0f);
+        product.assign(count, 0.0f);
+        solution.assign(count, 0.0f);
+        diagonal.assign(count, 0.0f);
+        linkStart.assign(count + 1, 0);
+        links.clear();
+        linkSplit.assign(count, 0);
+        for (size_t l = 0; l < count; l++) {
+            // Lower-numbered neighbors first, for the triangular solves.
+            for (int pass = 0; pass < 2; pass++) {
+                for (int f = faceStart[l]; f < faceStart[l + 1]; f++) {
+                    int other = faces[f].other;
+                    if (other >= 0 && (other < int(l)) == (pass == 0)) {
+                        diagonal[l] += faces[f].coefficient;
+                        links.push_back(Link{ other, faces[f].coefficient });
+                    }
+                }
+                if (pass == 0) {
+                    linkSplit[l] = int(links.size());
+                }
+            }
+            linkStart[l + 1] = int(links.size());
+        }
+        factorize();
+    }
+
+    template <typename Body>
+    void forLeaves(Body&& body) {
+        JobSystem::instance().parallelFor(0, leaves.size(), 256, [&](size_t begin, size_t end) {
+            for (size_t l = begin; l < end; l++) {
+                body(int(l));
+            }
+        });
+    }
+
+    void applyGravity(float dt) {
+        forLeaves([&](int l) {
+            int leaf = leaves[l];
+            v[leaf] = solid[l] ? 0.0f : v[leaf] + gravity * density[leaf] * dt;
+        });
+    }
+
+    // Bilinear-style blend of the leaf containing (x, y) with its neighbors on the side of
+    // the point, weighted by the distance between centers, which differs across levels.
+    float sample(const std::vector<float>& field, float x, float y, int from) const {
+        int a = locate(x, y, from);
+        const Node& node = nodes[a];
+        float half = 0.5f * node.size;
+        float cx = node.x + half;
+        float cy = node.y + half;
+        float sx = x >= cx ? 1.0f : -1.0f;
+        float sy = y >= cy ? 1.0f : -1.0f;
+
+        float px = cx + sx * (half + 0.5f);
+        float py = cy + sy * (half + 0.5f);
+        bool hasX = inside(px, y);
+        bool hasY = inside(x, py);
+        int bx = hasX ? locate(px, y, a) : a;
+        int by = hasY ? locate(x, py, a) : a;
+        int bxy = hasX && hasY ? locate(px, py, a) : (hasX ? bx : by);
+
+        float tx = hasX ? std::min(1.0f, std::fabs(x - cx) / (half + 0.5f * nodes[bx].size)) : 0.0f;
+        float ty = hasY ? std::min(1.0f, std::fabs(y - cy) / (half + 0.5f * nodes[by].size)) : 0.0f;
+
+        float low = field[a] + tx * (field[bx] - field[a]);
+        float high = field[by] + tx * (field[bxy] - field[by]);
+        return low + ty * (high - low);
+    }
+
+    void advect(std::vector<float>& d, const std::vector<float>& d0, float dt) {
+        forLeaves([&](int l) {
+            int leaf = leaves[l];
+            if (solid[l]) {
+                d[leaf] = 0.0f;
+                return;
+            }
+            const Node& node = nodes[leaf];
+            float x = node.x + 0.5f * node.size - dt * uPrev[leaf];
+            float y = node.y + 0.5f * node.size - dt * vPrev[leaf];
+            x = std::max(0.5f, std::min(x, N - 0.5f));
+            y = std::max(0.5f, std::min(y, N - 0.5f));
+            d[leaf] = sample(d0, x, y, leaf);
+        });
+    }
+
+    void multiply(const std::vector<float>& x, std::vector<float>& result) {
+        forLeaves([&](int l) {
+            float sum = diagonal[l] * x[l];
+            for (int n = linkStart[l]; n < linkStart[l + 1]; n++) {
+                sum -= links[n].coefficient * x[links[n].other];
+            }
+            result[l] = sum;
+        });
+    }
+
+    double dot(const std::vector<float>& a, const std::vector<float>& b) const {
+        double sum = 0.0;
+        for (size_t l = 0; l < a.size(); l++) {
+            sum += double(a[l]) * b[l];
+        }
+        return sum;
+    }
+
+    void project() {
+        size_t count = leaves.size();
+
+        // Integrated divergence from face velocities; closed faces carry none.
+        double mean = 0.0;
+        size_t fluidCells = 0;
+        forLeaves([&](int l) {
+            int leaf = leaves[l];
+            float flux = 0.0f;
+            for (int f = faceStart[l]; f < faceStart[l + 1]; f++) {
+                const Face& face = faces[f];
+                if (face.other >= 0) {
+                    int other = leaves[face.other];
+                    float un = 0.5f * ((u[leaf] + u[other]) * face.normalX + (v[leaf] + v[other]) * face.normalY);
+                    flux += un * face.length;
+                }
+            }
+            rhs[l] = diagonal[l] > 0.0f ? -flux : 0.0f;
+        });
+        for (size_t l = 0; l < count; l++) {
+            if (diagonal[l] > 0.0f) {
+                mean += rhs[l];
+                fluidCells++;
+            }
+        }
+        float shift = fluidCells > 0 ? float(mean / fluidCells) : 0.0f;
+
+        std::vector<float>& x = solution;
+        for (size_t l = 0; l < count; l++) {
+            if (diagonal[l] > 0.0f) {
+                rhs[l] -= shift;
+            }
+            x[l] = diagonal[l] > 0.0f ? pressure[leaves[l]] : 0.0f;
+        }
+
+        int iterations = solve(x);
+        series[FluidSimulation::PressureIterations].add(float(iterations));
+
+        forLeaves([&](int l) {
+            pressure[leaves[l]] = x[l];
+        });
+
+        // Green-Gauss gradient at the center; a closed face sees this cell's pressure.
+        forLeaves([&](int l) {
+            int leaf = leaves[l];
+            if (solid[l]) {
+                u[leaf] = v[leaf] = 0.0f;
+                return;
+            }
+            float gx = 0.0f;
+            float gy = 0.0f;
+            for (int f = faceStart[l]; f < faceStart[l + 1]; f++) {
+                const Face& face = faces[f];
+                float p = face.other >= 0 ? 0.5f * (x[l] + x[face.other]) : x[l];
+                gx += p * face.normalX * face.length;
+                gy += p * face.normalY * face.length;
+            }
+            float area = float(nodes[leaf].size) * nodes[leaf].size;
+            u[leaf] -= gx / area;
+            v[leaf] -= gy / area;
+        });
+    }
+
+    // Incomplete factorization M = (D + L) D^-1 (D + L^T), L the strict lower part of the
+    // leaf matrix in leaf (Morton) order and D chosen so that diag(M) = diag(A). Unlike
+    // FluidSimulation's grid a leaf's lower neighbors are not fixed offsets, so the
+    // factorization walks the face lists.
+    void factorize() {
+        size_t count = leaves.size();
+        inverseFactor.assign(count, 0.0f);
+        for (size_t l = 0; l < count; l++) {
+            if (diagonal[l] <= 0.0f) {
+                continue;
+            }
+            float d = diagonal[l];
+            for (int n = linkStart[l]; n < linkSplit[l]; n++) {
+                d -= links[n].coefficient * links[n].coefficient * inverseFactor[links[n].other];
+            }
+            inverseFactor[l] = 1.0f / (d < 0.25f * diagonal[l] ? diagonal[l] : d);
+        }
+    }
+
+    void precondition(const std::vector<float>& residual, std::vector<float>& result) const {
+        int count = int(leaves.size());
+        for (int l = 0; l < count; l++) {
+            float sum = residual[l];
+            for (int n = linkStart[l]; n < linkSplit[l]; n++) {
+                sum += links[n].coefficient * result[links[n].other];
+            }
+            result[l] = sum * inverseFactor[l];
+        }
+        for (int l = count - 1; l >= 0; l--) {
+            float sum = 0.0f;
+            for (int n = linkSplit[l]; n < linkStart[l + 1]; n++) {
+                sum += links[n].coefficient * result[links[n].other];
+            }
+            result[l] += sum * inverseFactor[l];
+        }
+    }
+
+    // Preconditioned CG on the leaf Laplacian, warm started from x.
+    int solve(std::vector<float>& x) {
+        size_t count = leaves.size();
+        multiply(x, product);
+        for (size_t l = 0; l < count; l++) {
+            r[l] = diagonal[l] > 0.0f ? rhs[l] - product[l] : 0.0f;
+        }
+
+        double rhsNorm = std::sqrt(dot(rhs, rhs));
+        if (rhsNorm == 0.0) {
+            series[FluidSimulation::PressureResidual].add(0.0f);
+            return 0;
+        }
+
+        precondition(r, z);
+        s = z;
+        double sigma = dot(z, r);
+        double residual = std::sqrt(dot(r, r)) / rhsNorm;
+
+        int iterations = 0;
+        while (iterations < maxIterations && residual > tolerance) {
+            iterations++;
+            multiply(s, product);
+            double denominator = dot(product, s);
+            if (denominator == 0.0) {
+                break;
+            }
+            float alpha = float(sigma / denominator);
+            for (size_t l = 0; l < count; l++) {
+                x[l] += alpha * s[l];
+                r[l] -= alpha * product[l];
+            }
+            residual = std::sqrt(dot(r, r)) / rhsNorm;
+            precondition(r, z);
+            double sigmaNew = dot(z, r);
+            float beta = float(sigmaNew / sigma);
+            for (size_t l = 0; l < count; l++) {
+                s[l] = z[l] + beta * s[l];
+            }
+            sigma = sigmaNew;
+        }
+        series[FluidSimulation::PressureResidual].add(float(residual));
+        return iterations;
+    }
+
+    bool wantsFine(int leaf) const {
+        const Node& node = nodes[leaf];
+        if (node.level >= maxLevel) {
+            return false;
+        }
+        if (node.level < minLevel || nearObstacleEdge(node)) {
+            return true;
+        }
+        for (int side = 0; side < 4; side++) {
+            int neighbors[2];
+            int found = sideNeighbors(leaf, side, neighbors);
+            for (int k = 0; k < found; k++) {
+                if (std::fabs(density[leaf] - density[neighbors[k]]) > interfaceTolerance) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    // Smallest neighbor size across all four sides, the node's own size if it has none.
+    int smallestNeighbor(int leaf) const {
+        const Node& node = nodes[leaf];
+        int smallest = node.size;
+        for (int side = 0; side < 4; side++) {
+            int neighbors[2];
+            int found = sideNeighbors(leaf, side, neighbors);
+            for (int k = 0; k < found; k++) {
+                smallest = std::min(smallest, nodes[neighbors[k]].size);
+            }
+        }
+        return smallest;
+    }
+
+    // One round of merging where four sibling leaves agree, then splitting where the
+    // field varies, then splitting until the tree is 2:1 balanced.
+    void adapt() {
+        std::vector<uint8_t> fine(nodes.size(), 0);
+        for (int leaf : leaves) {
+            fine[leaf] = wantsFine(leaf) ? 1 : 0;
+        }
+
+        std::vector<int> parents;
+        for (int leaf : leaves) {
+            int parent = nodes[leaf].parent;
+            if (parent >= 0 && nodes[parent].children == leaf) {
+                parents.push_back(parent);
+            }
+        }
+        for (int parent : parents) {
+            const Node& node = nodes[parent];
+            if (node.level < minLevel || nearObstacleEdge(node)) {
+                continue;
+            }
+            int first = node.children;
+            bool mergeable = true;
+            float low = density[first];
+            float high = density[first];
+            for (int k = 0; k < 4 && mergeable; k++) {
+                int child = first + k;
+                mergeable = nodes[child].children < 0 && !fine[child] && smallestNeighbor(child) >= nodes[child].size;
+                low = std::min(low, density[child]);
+                high = std::max(high, density[child]);
+            }
+            if (mergeable && high - low < coarsenTolerance) {
+                merge(parent);
+            }
+        }
+
+        for (int leaf : leaves) {
+            if (fine[leaf] && nodes[leaf].children < 0) {
+                split(leaf);
+            }
+        }
+
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            leaves.clear();
+            leafOf.assign(nodes.size(), -1);
+            collectLeaves(0);
+            std::vector<int> current = leaves;
+            for (int leaf : current) {
+                if (2 * smallestNeighbor(leaf) < nodes[leaf].size) {
+                    split(leaf);
+                    changed = true;
+                }
+            }
+        }
+
+        rebuild();
+    }
+};
+
+#endif
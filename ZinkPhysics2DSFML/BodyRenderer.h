@@ -0,0 +1,118 @@
+#ifndef BODY_RENDERER_H
+#define BODY_RENDERER_H
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cmath>
+#include "RigidBody.h"
+#include "RenderSnapshot.h"
+#include "JobSystem.h"
+
+// Draws every body as one textured quad out of a single vertex buffer. The texture
+// holds an anti-aliased disc in its left half and a solid block in its right half, so
+// circles and rectangles share one texture and one draw call.
+class BodyRenderer {
+public:
+    BodyRenderer() {
+        sf::Image atlas;
+        atlas.create(TEXTURE_SIZE * 2, TEXTURE_SIZE, sf::Color::White);
+        float center = TEXTURE_SIZE * 0.5f;
+        for (unsigned int y = 0; y < TEXTURE_SIZE; ++y) {
+            for (unsigned int x = 0; x < TEXTURE_SIZE; ++x) {
+                float dx = x + 0.5f - center;
+                float dy = y + 0.5f - center;
+                float coverage = std::min(std::max(center - std::sqrt(dx * dx + dy * dy), 0.0f), 1.0f);
+                atlas.setPixel(x, y, sf::Color(255, 255, 255, static_cast<sf::Uint8>(coverage * 255)));
+            }
+        }
+        texture.loadFromImage(atlas);
+        texture.setSmooth(true);
+
+        useVertexBuffer = sf::VertexBuffer::isAvailable();
+        vertexBuffer.setPrimitiveType(sf::Triangles);
+        vertexBuffer.setUsage(sf::VertexBuffer::Stream);
+    }
+
+    sf::Color circleColor = sf::Color::Red;
+    sf::Color rectangleColor = sf::Color::Blue;
+
+    // Rewrites all vertices straight from the snapshot arrays, split across the JobSystem.
+    void update(const RenderSnapshot& snapshot) {
+        size_t count = snapshot.x.size();
+        if (vertices.size() != count * VERTICES_PER_BODY) {
+            vertices.resize(count * VERTICES_PER_BODY);
+            if (useVertexBuffer) {
+                vertexBuffer.create(vertices.size());
+            }
+        }
+
+        JobSystem::instance().parallelFor(0, count, 1024, [&](size_t begin, size_t end) {
+            writeVertices(snapshot, begin, end);
+        });
+
+        if (useVertexBuffer && !vertices.empty()) {
+            vertexBuffer.update(vertices.data());
+        }
+    }
+
+    void draw(sf::RenderWindow& window) const {
+        if (vertices.empty()) {
+            return;
+        }
+
+        sf::RenderStates states;
+        states.texture = &texture;
+        if (useVertexBuffer) {
+            window.draw(vertexBuffer, states);
+        }
+        else {
+            window.draw(vertices.data(), vertices.size(), sf::Triangles, states);
+        }
+    }
+
+private:
+    static const unsigned int TEXTURE_SIZE = 64;
+    static const size_t VERTICES_PER_BODY = 6;
+
+    sf::Texture texture;
+    sf::VertexBuffer vertexBuffer;
+    std::vector<sf::Vertex> vertices;
+    bool useVertexBuffer = false;
+
+    void writeVertices(const RenderSnapshot& snapshot, size_t begin, size_t end) {
+        const float size = static_cast<float>(TEXTURE_SIZE);
+
+        for (size_t i = begin; i < end; ++i) {
+            bool circle = snapshot.shape[i] == static_cast<uint8_t>(RigidBody::ShapeType::Circle);
+            float r = snapshot.radius[i];
+            // A rectangle's radius is its half-diagonal (see RigidBody::radiusFromSize).
+            float half = circle ? r : r * 0.70710678f;
+            float c = std::cos(snapshot.angle[i]);
+            float s = std::sin(snapshot.angle[i]);
+            float ux = c * half, uy = s * half;
+            float vx = -s * half, vy = c * half;
+            float x = snapshot.x[i];
+            float y = snapshot.y[i];
+
+            // The solid half is inset by a texel so smoothing never samples the disc edge.
+            float u0 = circle ? 0.0f : size + 1.0f;
+            float u1 = circle ? size : 2.0f * size - 1.0f;
+            sf::Color color = circle ? circleColor : rectangleColor;
+
+            sf::Vertex topLeft(sf::Vector2f(x - ux - vx, y - uy - vy), color, sf::Vector2f(u0, 0));
+            sf::Vertex topRight(sf::Vector2f(x + ux - vx, y + uy - vy), color, sf::Vector2f(u1, 0));
+            sf::Vertex bottomRight(sf::Vector2f(x + ux + vx, y + uy + vy), color, sf::Vector2f(u1, size));
+            sf::Vertex bottomLeft(sf::Vector2f(x - ux + vx, y - uy + vy), color, sf::Vector2f(u0, size));
+
+            sf::Vertex* quad = &vertices[i * VERTICES_PER_BODY];
+            quad[0] = topLeft;
+            quad[1] = topRight;
+            quad[2] = bottomRight;
+            quad[3] = topLeft;
+            quad[4] = bottomRight;
+            quad[5] = bottomLeft;
+        }
+    }
+};
+
+#endif
@@ -4,37 +4,45 @@
 #include <SFML/Graphics.hpp>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include "Telemetry.h"
 
 class Chart {
 public:
+    static const size_t DEFAULT_HISTORY = 2048;
+
     Chart()
-        : xPos(0), yPos(0), chartWidth(200), chartHeight(100), chartColor(sf::Color::Black), chartTitle("") {
+        : xPos(0), yPos(0), chartWidth(200), chartHeight(100), chartColor(sf::Color::Black), chartTitle(""),
+        means(DEFAULT_HISTORY), peaks(DEFAULT_HISTORY), lines(sf::Lines) {
     }
 
-    Chart(float x, float y, float width, float height, const std::string& title, sf::Color color = sf::Color::Black)
-        : xPos(x), yPos(y), chartWidth(width), chartHeight(height), chartColor(color), chartTitle(title) {
+    Chart(float x, float y, float width, float height, const std::string& title, sf::Color color = sf::Color::Black, size_t history = DEFAULT_HISTORY)
+        : xPos(x), yPos(y), chartWidth(width), chartHeight(height), chartColor(color), chartTitle(title),
+        means(history), peaks(history), lines(sf::Lines) {
+        titleText.setFont(telemetryFont());
+        titleText.setString(chartTitle);
+        titleText.setCharacterSize(14);
+        titleText.setFillColor(sf::Color::Black);
+        titleText.setPosition(xPos, yPos - 20);
     }
 
     void addData(float value) {
-        data.push_back(value);
-        if (data.size() > static_cast<size_t>(chartWidth)) {
-            data.erase(data.begin());
-        }
+        means.push(value);
+        peaks.push(value);
+        dirty = true;
+    }
+
+    void addSample(const TelemetrySample& sample) {
+        means.push(sample.mean);
+        peaks.push(sample.max);
+        dirty = true;
     }
 
     void draw(sf::RenderWindow& window) {
-        sf::VertexArray lines(sf::LinesStrip);
-        for (size_t i = 0; i < data.size(); ++i) {
-            float x = xPos + i;
-            float y = yPos + chartHeight - data[i];
-            lines.append(sf::Vertex(sf::Vector2f(x, y), chartColor));
+        if (dirty) {
+            rebuild();
+            dirty = false;
         }
-
-        sf::Font font;
-        font.loadFromFile("arial.ttf");
-        sf::Text titleText(chartTitle, font, 14);
-        titleText.setFillColor(sf::Color::Black);
-        titleText.setPosition(xPos, yPos - 20);
         window.draw(titleText);
         window.draw(lines);
     }
@@ -42,7 +50,59 @@ public:
 private:
     float xPos, yPos, chartWidth, chartHeight;
     sf::Color chartColor;
-    std::vector<float> data;
     std::string chartTitle;
+    RingBuffer<float> means, peaks;
+    sf::VertexArray lines;
+    sf::Text titleText;
+    bool dirty = true;
+
+    float toScreen(float value) const {
+        return yPos + chartHeight - value;
+    }
+
+    // One column per pixel. When the history is longer than the chart is wide each
+    // column shows the min/max envelope of its bucket, so spikes are never dropped.
+    void rebuild() {
+        lines.clear();
+        size_t count = means.size();
+        size_t columns = std::min(count, static_cast<size_t>(chartWidth));
+        if (columns == 0) {
+            return;
+        }
+
+        sf::Color peakColor = chartColor;
+        peakColor.a = 96;
+        float previousLast = 0.0f;
+        float previousPeak = 0.0f;
+
+        for (size_t c = 0; c < columns; ++c) {
+            size_t begin = c * count / columns;
+            size_t end = std::max(begin + 1, (c + 1) * count / columns);
+
+            float low = means[begin];
+            float high = means[begin];
+            float peak = peaks[begin];
+            for (size_t i = begin + 1; i < end; ++i) {
+                low = std::min(low, means[i]);
+                high = std::max(high, means[i]);
+                peak = std::max(peak, peaks[i]);
+            }
+
+            float x = xPos + c;
+            if (c > 0) {
+                lines.append(sf::Vertex(sf::Vector2f(x - 1, toScreen(previousLast)), chartColor));
+                lines.append(sf::Vertex(sf::Vector2f(x, toScreen(means[begin])), chartColor));
+                lines.append(sf::Vertex(sf::Vector2f(x - 1, toScreen(previousPeak)), peakColor));
+                lines.append(sf::Vertex(sf::Vector2f(x, toScreen(peak)), peakColor));
+            }
+            if (high > low) {
+                lines.append(sf::Vertex(sf::Vector2f(x, toScreen(low)), chartColor));
+                lines.append(sf::Vertex(sf::Vector2f(x, toScreen(high)), chartColor));
+            }
+
+            previousLast = means[end - 1];
+            previousPeak = peak;
+        }
+    }
 };
 #endif
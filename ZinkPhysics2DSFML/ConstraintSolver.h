@@ -0,0 +1,341 @@
+#ifndef CONSTRAINT_SOLVER_H
+#define CONSTRAINT_SOLVER_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "RigidBody.h"
+#include "Vector2D.h"
+#include "JobSystem.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CONSTRAINT_SOLVER_SSE 1
+#endif
+
+struct ContactConstraint {
+    int bodyA;
+    int bodyB; // -1 when the contact is against static geometry
+    Vector2D normal; // points from A to B
+    float penetration;
+    float restitution;
+    float friction;
+
+    float normalMass = 0.0f;
+    float tangentMass = 0.0f;
+    float velocityBias = 0.0f;
+    float normalImpulse = 0.0f;
+    float tangentImpulse = 0.0f;
+
+    ContactConstraint(int a, int b, const Vector2D& normal, float penetration, float restitution = 0.9f, float friction = 0.5f)
+        : bodyA(a), bodyB(b), normal(normal), penetration(penetration), restitution(restitution), friction(friction) {
+    }
+};
+
+// Circle proxies for every body pair, same broad test as RigidBody::checkCollision.
+void buildContacts(const std::vector<RigidBody>& bodies, std::vector<ContactConstraint>& contacts) {
+    for (size_t i = 0; i < bodies.size(); ++i) {
+        for (size_t j = i + 1; j < bodies.size(); ++j) {
+            Vector2D diff = bodies[j].position - bodies[i].position;
+            float radiusSum = bodies[i].radius + bodies[j].radius;
+            float distanceSquared = diff.lengthSquared();
+            if (distanceSquared >= radiusSum * radiusSum) {
+                continue;
+            }
+
+            float distance = std::sqrt(distanceSquared);
+            Vector2D normal = distance > 0.0f ? diff / distance : Vector2D(0, 1);
+            contacts.emplace_back(static_cast<int>(i), static_cast<int>(j), normal, radiusSum - distance);
+        }
+    }
+}
+
+// Sequential-impulse contact solver. Constraints are greedily colored so that no two
+// constraints in a color touch the same dynamic body; each color is then split across
+// the shared JobSystem. Colors are visited in a fixed order, which is itself a valid
+// Gauss-Seidel ordering, so the result matches a serial sweep over the same sequence.
+class ConstraintSolver {
+public:
+    int iterations = 8;
+    float baumgarte = 0.2f;
+    float penetrationSlop = 0.5f;
+    float restitutionThreshold = 1.0f;
+    bool useSimd = true;
+    size_t parallelThreshold = 1024;
+    JobSystem* jobs = &JobSystem::instance();
+
+    void solve(std::vector<RigidBody>& bodies, std::vector<ContactConstraint>& contacts, float dt) {
+        if (contacts.empty()) {
+            return;
+        }
+
+        loadBodies(bodies);
+        buildColors(bodies.size(), contacts);
+        prepare(contacts, dt);
+
+        for (int iteration = 0; iteration < iterations; ++iteration) {
+            for (const auto& color : colors) {
+                solveColor(contacts, color);
+            }
+            for (int index : overflow) {
+                solveContact(contacts[index]);
+            }
+        }
+
+        storeBodies(bodies);
+    }
+
+    size_t getColorCount() const {
+        return colors.size();
+    }
+
+private:
+    static const int MAX_COLORS = 64;
+
+    std::vector<float> vx, vy, w, invMass, invInertia, radius;
+    std::vector<std::vector<int>> colors;
+    std::vector<int> overflow;
+    std::vector<uint64_t> bodyColorMask;
+    size_t staticIndex = 0;
+
+    int slot(int body) const {
+        return body < 0 ? static_cast<int>(staticIndex) : body;
+    }
+
+    void loadBodies(const std::vector<RigidBody>& bodies) {
+        staticIndex = bodies.size();
+        size_t count = bodies.size() + 1;
+        vx.assign(count, 0.0f);
+        vy.assign(count, 0.0f);
+        w.assign(count, 0.0f);
+        invMass.assign(count, 0.0f);
+        invInertia.assign(count, 0.0f);
+        radius.assign(count, 0.0f);
+
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            vx[i] = bodies[i].velocity.x;
+            vy[i] = bodies[i].velocity.y;
+            w[i] = bodies[i].angularVelocity;
+            invMass[i] = bodies[i].invMass;
+            invInertia[i] = bodies[i].invInertia;
+            radius[i] = bodies[i].radius;
+        }
+    }
+
+    void storeBodies(std::vector<RigidBody>& bodies) const {
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            bodies[i].velocity = Vector2D(vx[i], vy[i]);
+            bodies[i].angularVelocity = w[i];
+        }
+    }
+
+    void buildColors(size_t bodyCount, const std::vector<ContactConstraint>& contacts) {
+        for (auto& color : colors) {
+            color.clear();
+        }
+        overflow.clear();
+        bodyColorMask.assign(bodyCount, 0);
+
+        for (size_t i = 0; i < contacts.size(); ++i) {
+            const ContactConstraint& c = contacts[i];
+            uint64_t used = 0;
+            if (c.bodyA >= 0) used |= bodyColorMask[c.bodyA];
+            if (c.bodyB >= 0) used |= bodyColorMask[c.bodyB];
+
+            int color = 0;
+            while (color < MAX_COLORS && (used & (uint64_t(1) << color))) {
+                ++color;
+            }
+
+            if (color == MAX_COLORS) {
+                overflow.push_back(static_cast<int>(i));
+                continue;
+            }
+
+            if (static_cast<size_t>(color) >= colors.size()) {
+                colors.resize(color + 1);
+            }
+            colors[color].push_back(static_cast<int>(i));
+            if (c.bodyA >= 0) bodyColorMask[c.bodyA] |= uint64_t(1) << color;
+            if (c.bodyB >= 0) bodyColorMask[c.bodyB] |= uint64_t(1) << color;
+        }
+
+        while (!colors.empty() && colors.back().empty()) {
+            colors.pop_back();
+        }
+    }
+
+    void prepare(std::vector<ContactConstraint>& contacts, float dt) {
+        for (auto& c : contacts) {
+            int a = slot(c.bodyA);
+            int b = slot(c.bodyB);
+
+            float massSum = invMass[a] + invMass[b];
+            c.normalMass = massSum > 0.0f ? 1.0f / massSum : 0.0f;
+
+            float tangentSum = massSum + radius[a] * radius[a] * invInertia[a] + radius[b] * radius[b] * invInertia[b];
+            c.tangentMass = tangentSum > 0.0f ? 1.0f / tangentSum : 0.0f;
+
+            float relativeNormal = (vx[b] - vx[a]) * c.normal.x + (vy[b] - vy[a]) * c.normal.y;
+            c.velocityBias = baumgarte / dt * std::max(c.penetration - penetrationSlop, 0.0f);
+            if (relativeNormal < -restitutionThreshold) {
+                c.velocityBias = std::max(c.velocityBias, -c.restitution * relativeNormal);
+            }
+
+            c.normalImpulse = 0.0f;
+            c.tangentImpulse = 0.0f;
+        }
+    }
+
+    void solveContact(ContactConstraint& c) {
+        int a = slot(c.bodyA);
+        int b = slot(c.bodyB);
+        float nx = c.normal.x;
+        float ny = c.normal.y;
+
+        // Contact points sit on the surface: rA = n * radiusA, rB = -n * radiusB.
+        float dvx = vx[b] + w[b] * radius[b] * ny - vx[a] + w[a] * radius[a] * ny;
+        float dvy = vy[b] - w[b] * radius[b] * nx - vy[a] - w[a] * radius[a] * nx;
+
+        float vn = dvx * nx + dvy * ny;
+        float lambda = c.normalMass * (c.velocityBias - vn);
+        float oldImpulse = c.normalImpulse;
+        c.normalImpulse = std::max(oldImpulse + lambda, 0.0f);
+        lambda = c.normalImpulse - oldImpulse;
+
+        vx[a] -= lambda * nx * invMass[a];
+        vy[a] -= lambda * ny * invMass[a];
+        vx[b] += lambda * nx * invMass[b];
+        vy[b] += lambda * ny * invMass[b];
+
+        float tx = -ny;
+        float ty = nx;
+        dvx = vx[b] + w[b] * radius[b] * ny - vx[a] + w[a] * radius[a] * ny;
+        dvy = vy[b] - w[b] * radius[b] * nx - vy[a] - w[a] * radius[a] * nx;
+
+        float vt = dvx * tx + dvy * ty;
+        float maxFriction = c.friction * c.normalImpulse;
+        float lambdaT = -c.tangentMass * vt;
+        float oldTangent = c.tangentImpulse;
+        c.tangentImpulse = std::max(-maxFriction, std::min(oldTangent + lambdaT, maxFriction));
+        lambdaT = c.tangentImpulse - oldTangent;
+
+        vx[a] -= lambdaT * tx * invMass[a];
+        vy[a] -= lambdaT * ty * invMass[a];
+        w[a] -= lambdaT * radius[a] * invInertia[a];
+        vx[b] += lambdaT * tx * invMass[b];
+        vy[b] += lambdaT * ty * invMass[b];
+        w[b] -= lambdaT * radius[b] * invInertia[b];
+    }
+
+#ifdef CONSTRAINT_SOLVER_SSE
+    // Four constraints of one color at a time. They share no dynamic body, so the
+    // gathered lanes are independent and the scatter cannot collide.
+    void solveContactsSimd(std::vector<ContactConstraint>& contacts, const int* indices) {
+        alignas(16) float ax[4], ay[4], aw[4], aim[4], aii[4], ar[4];
+        alignas(16) float bx[4], by[4], bw[4], bim[4], bii[4], br[4];
+        alignas(16) float nx[4], ny[4], nm[4], tm[4], bias[4], fr[4], pn[4], pt[4];
+
+        for (int l = 0; l < 4; ++l) {
+            const ContactConstraint& c = contacts[indices[l]];
+            int a = slot(c.bodyA);
+            int b = slot(c.bodyB);
+            ax[l] = vx[a]; ay[l] = vy[a]; aw[l] = w[a]; aim[l] = invMass[a]; aii[l] = invInertia[a]; ar[l] = radius[a];
+            bx[l] = vx[b]; by[l] = vy[b]; bw[l] = w[b]; bim[l] = invMass[b]; bii[l] = invInertia[b]; br[l] = radius[b];
+            nx[l] = c.normal.x; ny[l] = c.normal.y; nm[l] = c.normalMass; tm[l] = c.tangentMass;
+            bias[l] = c.velocityBias; fr[l] = c.friction; pn[l] = c.normalImpulse; pt[l] = c.tangentImpulse;
+        }
+
+        __m128 vax = _mm_load_ps(ax), vay = _mm_load_ps(ay), vaw = _mm_load_ps(aw);
+        __m128 vbx = _mm_load_ps(bx), vby = _mm_load_ps(by), vbw = _mm_load_ps(bw);
+        __m128 imA = _mm_load_ps(aim), imB = _mm_load_ps(bim);
+        __m128 iiA = _mm_load_ps(aii), iiB = _mm_load_ps(bii);
+        __m128 rA = _mm_load_ps(ar), rB = _mm_load_ps(br);
+        __m128 n_x = _mm_load_ps(nx), n_y = _mm_load_ps(ny);
+        __m128 zero = _mm_setzero_ps();
+
+        auto relative = [&](__m128& dvx, __m128& dvy) {
+            __m128 wrA = _mm_mul_ps(vaw, rA);
+            __m128 wrB = _mm_mul_ps(vbw, rB);
+            dvx = _mm_add_ps(_mm_sub_ps(vbx, vax), _mm_mul_ps(_mm_add_ps(wrA, wrB), n_y));
+            dvy = _mm_sub_ps(_mm_sub_ps(vby, vay), _mm_mul_ps(_mm_add_ps(wrA, wrB), n_x));
+        };
+
+        __m128 dvx, dvy;
+        relative(dvx, dvy);
+        __m128 vn = _mm_add_ps(_mm_mul_ps(dvx, n_x), _mm_mul_ps(dvy, n_y));
+        __m128 oldN = _mm_load_ps(pn);
+        __m128 newN = _mm_max_ps(_mm_add_ps(oldN, _mm_mul_ps(_mm_load_ps(nm), _mm_sub_ps(_mm_load_ps(bias), vn))), zero);
+        __m128 lambda = _mm_sub_ps(newN, oldN);
+
+        __m128 px = _mm_mul_ps(lambda, n_x);
+        __m128 py = _mm_mul_ps(lambda, n_y);
+        vax = _mm_sub_ps(vax, _mm_mul_ps(px, imA));
+        vay = _mm_sub_ps(vay, _mm_mul_ps(py, imA));
+        vbx = _mm_add_ps(vbx, _mm_mul_ps(px, imB));
+        vby = _mm_add_ps(vby, _mm_mul_ps(py, imB));
+
+        __m128 t_x = _mm_sub_ps(zero, n_y);
+        __m128 t_y = n_x;
+        relative(dvx, dvy);
+        __m128 vt = _mm_add_ps(_mm_mul_ps(dvx, t_x), _mm_mul_ps(dvy, t_y));
+        __m128 maxF = _mm_mul_ps(_mm_load_ps(fr), newN);
+        __m128 oldT = _mm_load_ps(pt);
+        __m128 newT = _mm_sub_ps(oldT, _mm_mul_ps(_mm_load_ps(tm), vt));
+        newT = _mm_max_ps(_mm_sub_ps(zero, maxF), _mm_min_ps(newT, maxF));
+        __m128 lambdaT = _mm_sub_ps(newT, oldT);
+
+        px = _mm_mul_ps(lambdaT, t_x);
+        py = _mm_mul_ps(lambdaT, t_y);
+        vax = _mm_sub_ps(vax, _mm_mul_ps(px, imA));
+        vay = _mm_sub_ps(vay, _mm_mul_ps(py, imA));
+        vaw = _mm_sub_ps(vaw, _mm_mul_ps(_mm_mul_ps(lambdaT, rA), iiA));
+        vbx = _mm_add_ps(vbx, _mm_mul_ps(px, imB));
+        vby = _mm_add_ps(vby, _mm_mul_ps(py, imB));
+        vbw = _mm_sub_ps(vbw, _mm_mul_ps(_mm_mul_ps(lambdaT, rB), iiB));
+
+        _mm_store_ps(ax, vax); _mm_store_ps(ay, vay); _mm_store_ps(aw, vaw);
+        _mm_store_ps(bx, vbx); _mm_store_ps(by, vby); _mm_store_ps(bw, vbw);
+        _mm_store_ps(pn, newN); _mm_store_ps(pt, newT);
+
+        for (int l = 0; l < 4; ++l) {
+            ContactConstraint& c = contacts[indices[l]];
+            c.normalImpulse = pn[l];
+            c.tangentImpulse = pt[l];
+            if (c.bodyA >= 0) {
+                vx[c.bodyA] = ax[l]; vy[c.bodyA] = ay[l]; w[c.bodyA] = aw[l];
+            }
+            if (c.bodyB >= 0) {
+                vx[c.bodyB] = bx[l]; vy[c.bodyB] = by[l]; w[c.bodyB] = bw[l];
+            }
+        }
+    }
+#endif
+
+    void solveRange(std::vector<ContactConstraint>& contacts, const std::vector<int>& color, size_t begin, size_t end) {
+        size_t i = begin;
+#ifdef CONSTRAINT_SOLVER_SSE
+        if (useSimd) {
+            for (; i + 4 <= end; i += 4) {
+                solveContactsSimd(contacts, &color[i]);
+            }
+        }
+#endif
+        for (; i < end; ++i) {
+            solveContact(contacts[color[i]]);
+        }
+    }
+
+    void solveColor(std::vector<ContactConstraint>& contacts, const std::vector<int>& color) {
+        if (color.size() < parallelThreshold || !jobs) {
+            solveRange(contacts, color, 0, color.size());
+            return;
+        }
+
+        jobs->parallelFor(0, color.size(), parallelThreshold / 4, [&](size_t begin, size_t end) {
+            solveRange(contacts, color, begin, end);
+        });
+    }
+};
+
+#endif
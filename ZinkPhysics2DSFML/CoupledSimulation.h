@@ -0,0 +1,258 @@
+#ifndef COUPLED_SIMULATION_H
+#define COUPLED_SIMULATION_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "JobSystem.h"
+#include "RenderSnapshot.h"
+#include "FluidSimulation.h"
+#include "RigidBody.h"
+#include "World.h"
+
+// Rigid bodies floating in a FluidSimulation, coupled both ways. Bodies live in pixels
+// and the fluid in cells of cellSize pixels; every body is treated as a circle of its
+// radius, the same shape World collides it as.
+//
+// Body to fluid: each step every body is rasterized as solid cells moving with its
+// rigid velocity, so the projection pushes fluid out of its way. Fluid density caught
+// under a body that moved in is pushed out radially to just past its surface.
+//
+// Fluid to body: pressure impulse and velocity are sampled on a ring just outside each
+// body. The pressure integrated around the ring gives buoyancy and form forces, and the
+// mean relative velocity drives a quadratic drag through the body's dragCoefficient.
+// Fluid density is 1 in these units, so a body's mass is its density times its area in
+// cells and bodies lighter than 1 float.
+//
+// Part of the sampled pressure is the fluid resisting the body's own acceleration last
+// step, an added mass of about its area. Fed back explicitly that makes light bodies
+// blow up, so it is added to both sides: the body is accelerated as if that much heavier
+// and the lagged reaction is cancelled with last step's acceleration.
+//
+// Rasterization walks each body's bounding box and sampling a fixed ring per body, so
+// both passes cost the bodies' area and count, never a body search per cell.
+class CoupledSimulation {
+public:
+    int ringSamples = 24;
+
+    CoupledSimulation(int gridSize, float cellSize, float timestep)
+        : N(gridSize), cellSize(cellSize), fluid(gridSize, timestep, 0.4f),
+        world(Vector2D(0, fluid.gravity * cellSize), gridSize * cellSize, gridSize * cellSize),
+        bodyMask(N * N, 0) {
+        world.maxVelocity = 100.0f * cellSize;
+        fluid.recordPressureImpulse = true;
+    }
+
+    FluidSimulation& getFluid() {
+        return fluid;
+    }
+
+    const std::vector<RigidBody>& getBodies() const {
+        return world.getBodies();
+    }
+
+    // A circle at a pixel position with the given density relative to the fluid.
+    int addBody(const Vector2D& position, float radius, float density, float dragCoefficient = 1.0f) {
+        float cells = radius / cellSize;
+        RigidBody body(density * 3.14159265f * cells * cells, position, RigidBody::ShapeType::Circle, 0.0f, dragCoefficient);
+        body.radius = radius;
+        body.updateInertiaForShape();
+        return world.addBody(body);
+    }
+
+    void update(float timestep) {
+        rasterizeBodies();
+        fluid.update(timestep);
+        applyFluidForces(timestep);
+        world.step(timestep);
+    }
+
+    // Fluid fields with the bodies as solid cells, plus the bodies themselves.
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        fluid.writeSnapshot(snapshot);
+
+        const std::vector<RigidBody>& bodies = world.getBodies();
+        size_t count = bodies.size();
+        snapshot.x.resize(count);
+        snapshot.y.resize(count);
+        snapshot.angle.resize(count);
+        snapshot.radius.resize(count);
+        snapshot.shape.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            snapshot.x[i] = bodies[i].position.x;
+            snapshot.y[i] = bodies[i].position.y;
+            snapshot.angle[i] = bodies[i].angle;
+            snapshot.radius[i] = bodies[i].radius;
+            snapshot.shape[i] = static_cast<uint8_t>(bodies[i].shapeType);
+        }
+    }
+
+private:
+    int N;
+    float cellSize;
+    FluidSimulation fluid;
+    World world;
+
+    // Cells the bodies covered last step; bodyMask marks them so they can be released.
+    std::vector<int> bodyCells;
+    std::vector<uint8_t> bodyMask;
+    std::vector<uint8_t> staticSolid;
+    std::vector<Vector2D> lastAcceleration; // cells / s^2, gravity included
+
+    // Body center in grid coordinates, where cell i spans [i, i + 1) times cellSize.
+    float toGrid(float pixels) const {
+        return pixels / cellSize - 0.5f;
+    }
+
+    void rasterizeBodies() {
+        if (staticSolid.empty()) {
+            staticSolid.resize(N * N);
+            for (int c = 0; c < N * N; c++) {
+                staticSolid[c] = fluid.isSolid(c % N, c / N) ? 1 : 0;
+            }
+        }
+
+        for (int c : bodyCells) {
+            fluid.setSolid(c % N, c / N, staticSolid[c] != 0);
+            fluid.setSolidVelocity(c % N, c / N, 0.0f, 0.0f);
+            bodyMask[c] = 0;
+        }
+        bodyCells.clear();
+
+        std::vector<float>& density = fluid.getDensity();
+        for (const RigidBody& body : world.getBodies()) {
+            float cx = toGrid(body.position.x);
+            float cy = toGrid(body.position.y);
+            float r = body.radius / cellSize;
+            float su = body.velocity.x / cellSize;
+            float sv = body.velocity.y / cellSize;
+
+            int i0 = std::max(int(std::ceil(cx - r)), 1);
+            int i1 = std::min(int(std::floor(cx + r)), N - 2);
+            int j0 = std::max(int(std::ceil(cy - r)), 1);
+            int j1 = std::min(int(std::floor(cy + r)), N - 2);
+            for (int j = j0; j <= j1; j++) {
+                for (int i = i0; i <= i1; i++) {
+                    float dx = i - cx;
+                    float dy = j - cy;
+                    int c = i + j * N;
+                    if (dx * dx + dy * dy > r * r || staticSolid[c] || bodyMask[c]) {
+                        continue;
+                    }
+
+                    // Rigid velocity at the cell, spin included.
+                    fluid.setSolid(i, j, true);
+                    fluid.setSolidVelocity(i, j, su - body.angularVelocity * dy, sv + body.angularVelocity * dx);
+                    bodyMask[c] = 1;
+                    bodyCells.push_back(c);
+
+                    if (density[c] > 0.0f) {
+                        displaceDensity(density, c, dx, dy, cx, cy, r);
+                    }
+                }
+            }
+        }
+    }
+
+    // Moves a covered cell's density along the radius to the first cell past the surface.
+    void displaceDensity(std::vector<float>& density, int c, float dx, float dy, float cx, float cy, float r) {
+        float length = std::sqrt(dx * dx + dy * dy);
+        if (length < 1e-3f) {
+            dx = 0.0f;
+            dy = -1.0f;
+            length = 1.0f;
+        }
+        int i = int(std::lround(cx + dx / length * (r + 1.0f)));
+        int j = int(std::lround(cy + dy / length * (r + 1.0f)));
+        if (i > 0 && i < N - 1 && j > 0 && j < N - 1 && !fluid.isSolid(i, j)) {
+            density[i + j * N] += density[c];
+            density[c] = 0.0f;
+        }
+    }
+
+    // Pressure and velocity averaged over the fluid taps of a bilinear lookup; taps inside
+    // solids carry no pressure of their own and are left out rather than read as zero.
+    void sampleFluid(float x, float y, float& pressure, float& u, float& v) const {
+        x = std::min(std::max(x, 0.0f), N - 1.001f);
+        y = std::min(std::max(y, 0.0f), N - 1.001f);
+        int i = int(x);
+        int j = int(y);
+        float fx = x - i;
+        float fy = y - j;
+        float weights[4] = { (1 - fx) * (1 - fy), fx * (1 - fy), (1 - fx) * fy, fx * fy };
+        int cells[4] = { i + j * N, i + 1 + j * N, i + (j + 1) * N, i + 1 + (j + 1) * N };
+
+        const std::vector<float>& impulse = fluid.getPressureImpulse();
+        const std::vector<float>& fluidU = fluid.getU();
+        const std::vector<float>& fluidV = fluid.getV();
+        float total = 0.0f;
+        pressure = u = v = 0.0f;
+        for (int k = 0; k < 4; k++) {
+            if (fluid.isSolid(cells[k] % N, cells[k] / N)) {
+                continue;
+            }
+            total += weights[k];
+            pressure += weights[k] * impulse[cells[k]];
+            u += weights[k] * fluidU[cells[k]];
+            v += weights[k] * fluidV[cells[k]];
+        }
+        if (total > 0.0f) {
+            pressure /= total;
+            u /= total;
+            v /= total;
+        }
+    }
+
+    // The pressure impulse over a step is dt times the pressure, so dividing by dt gives
+    // the force. The ring sits half a cell outside the body so its taps are mostly fluid;
+    // its integral is scaled back to the body's own area.
+    void applyFluidForces(float timestep) {
+        std::vector<RigidBody>& bodies = world.getBodies();
+        lastAcceleration.resize(bodies.size(), Vector2D(0, 0));
+        float gravity = fluid.gravity;
+        JobSystem::instance().parallelFor(0, bodies.size(), 16, [&](size_t begin, size_t end) {
+            for (size_t b = begin; b < end; ++b) {
+                RigidBody& body = bodies[b];
+                float cx = toGrid(body.position.x);
+                float cy = toGrid(body.position.y);
+                float r = body.radius / cellSize;
+                float ring = r + 0.5f;
+                float arc = 2.0f * 3.14159265f * ring / ringSamples * (r * r) / (ring * ring);
+
+                float forceX = 0.0f, forceY = 0.0f;
+                float meanU = 0.0f, meanV = 0.0f;
+                for (int k = 0; k < ringSamples; k++) {
+                    float theta = 2.0f * 3.14159265f * k / ringSamples;
+                    float nx = std::cos(theta);
+                    float ny = std::sin(theta);
+                    float pressure, u, v;
+                    sampleFluid(cx + nx * ring, cy + ny * ring, pressure, u, v);
+                    forceX -= pressure * nx * arc;
+                    forceY -= pressure * ny * arc;
+                    meanU += u;
+                    meanV += v;
+                }
+                forceX /= timestep;
+                forceY /= timestep;
+
+                // Drag on the frontal width 2r, with fluid density 1.
+                float relativeU = meanU / ringSamples - body.velocity.x / cellSize;
+                float relativeV = meanV / ringSamples - body.velocity.y / cellSize;
+                float speed = std::sqrt(relativeU * relativeU + relativeV * relativeV);
+                forceX += body.dragCoefficient * r * speed * relativeU;
+                forceY += body.dragCoefficient * r * speed * relativeV;
+
+                // World adds gravity itself; this is the rest of the acceleration.
+                float mass = body.mass;
+                float addedMass = 3.14159265f * r * r;
+                Vector2D previous = lastAcceleration[b];
+                Vector2D acceleration = (Vector2D(forceX, forceY + mass * gravity) + previous * addedMass) / (mass + addedMass);
+                lastAcceleration[b] = acceleration;
+                body.applyForce(Vector2D(acceleration.x, acceleration.y - gravity) * (mass * cellSize));
+            }
+        });
+    }
+};
+
+#endif
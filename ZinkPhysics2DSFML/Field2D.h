@@ -0,0 +1,274 @@
+#ifndef FIELD2D_H
+#define FIELD2D_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <iterator>
+#include "JobSystem.h"
+
+// Scalar field stored as Tile x Tile blocks laid out in Morton (Z) order, each padded with
+// a one-cell ghost ring. A tile plus its ghosts is a small contiguous block, (16 + 2)^2
+// floats = 1.3 KB at the default size, so a 5-point stencil over a tile touches only that
+// block instead of striding across whole rows of a row-major grid.
+//
+// Cells are addressed with global (i, j) as in the flat fields. Ghosts hold copies of the
+// neighboring tiles' edge cells and are refreshed by updateGhosts(); edge ghosts only,
+// which is all a 5-point stencil reads.
+template <int Tile = 16>
+class Field2D {
+    static_assert(Tile >= 4 && (Tile & (Tile - 1)) == 0, "Tile must be a power of two");
+
+public:
+    static const int TILE = Tile;
+    static const int PADDED = Tile + 2;
+    static const int TILE_CELLS = PADDED * PADDED;
+
+    // A tile's block. Local coordinates run from -1 to Tile (ghosts included).
+    struct TileView {
+        int x0 = 0, y0 = 0;        // global coordinates of local (0, 0)
+        int width = 0, height = 0; // cells of the tile inside the field
+        float* data = nullptr;
+
+        float& at(int li, int lj) const {
+            return data[(lj + 1) * PADDED + li + 1];
+        }
+    };
+
+    struct Cell {
+        int i, j;
+        float& value;
+    };
+
+    // Visits every cell in storage order: tile by tile, rows within a tile.
+    class iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Cell;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = Cell;
+
+        iterator(Field2D* field, int slot, int li, int lj) : field(field), slot(slot), li(li), lj(lj) {
+        }
+
+        Cell operator*() const {
+            TileView view = field->tile(slot);
+            return Cell{ view.x0 + li, view.y0 + lj, view.at(li, lj) };
+        }
+
+        iterator& operator++() {
+            TileView view = field->tile(slot);
+            if (++li < view.width) {
+                return *this;
+            }
+            li = 0;
+            if (++lj < view.height) {
+                return *this;
+            }
+            lj = 0;
+            ++slot;
+            return *this;
+        }
+
+        bool operator==(const iterator& other) const {
+            return slot == other.slot && li == other.li && lj == other.lj;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        Field2D* field;
+        int slot, li, lj;
+    };
+
+    Field2D() = default;
+
+    Field2D(int width, int height, float value = 0.0f) {
+        resize(width, height, value);
+    }
+
+    void resize(int width, int height, float value = 0.0f) {
+        fieldWidth = width;
+        fieldHeight = height;
+        tilesX = (width + Tile - 1) / Tile;
+        tilesY = (height + Tile - 1) / Tile;
+
+        // Rank the tiles by the Morton code of their tile coordinates, which also works
+        // when the tile grid is not a power of two on a side.
+        std::vector<std::pair<uint32_t, int>> order;
+        order.reserve(tilesX * tilesY);
+        for (int ty = 0; ty < tilesY; ty++) {
+            for (int tx = 0; tx < tilesX; tx++) {
+                order.push_back({ morton(tx, ty), tx + ty * tilesX });
+            }
+        }
+        std::sort(order.begin(), order.end());
+
+        tileSlot.assign(order.size(), 0);
+        slotTile.assign(order.size(), 0);
+        for (size_t slot = 0; slot < order.size(); slot++) {
+            slotTile[slot] = order[slot].second;
+            tileSlot[order[slot].second] = int(slot);
+        }
+        data.assign(order.size() * TILE_CELLS, value);
+    }
+
+    int width() const {
+        return fieldWidth;
+    }
+
+    int height() const {
+        return fieldHeight;
+    }
+
+    int tileCount() const {
+        return tilesX * tilesY;
+    }
+
+    float& operator()(int i, int j) {
+        return data[offset(i, j)];
+    }
+
+    float operator()(int i, int j) const {
+        return data[offset(i, j)];
+    }
+
+    // slot is the storage (Morton) position, 0 .. tileCount() - 1.
+    TileView tile(int slot) {
+        int t = slotTile[slot];
+        TileView view;
+        view.x0 = (t % tilesX) * Tile;
+        view.y0 = (t / tilesX) * Tile;
+        view.width = std::min(Tile, fieldWidth - view.x0);
+        view.height = std::min(Tile, fieldHeight - view.y0);
+        view.data = &data[static_cast<size_t>(slot) * TILE_CELLS];
+        return view;
+    }
+
+    iterator begin() {
+        return iterator(this, 0, 0, 0);
+    }
+
+    iterator end() {
+        return iterator(this, tileCount(), 0, 0);
+    }
+
+    // Runs body(TileView) for every tile, spread across the job system in storage order.
+    template <typename Body>
+    void forEachTile(Body&& body) {
+        JobSystem::instance().parallelFor(0, tileCount(), 4, [&](size_t begin, size_t end) {
+            for (size_t slot = begin; slot < end; slot++) {
+                body(tile(int(slot)));
+            }
+        });
+    }
+
+    // Copies each tile's neighbors' edge cells into its ghost ring. Outside the field the
+    // ghost repeats the tile's own edge.
+    void updateGhosts() {
+        forEachTile([&](const TileView& view) {
+            int tx = view.x0 / Tile;
+            int ty = view.y0 / Tile;
+            const float* left = tx > 0 ? neighbor(tx - 1, ty).data : nullptr;
+            const float* right = tx + 1 < tilesX ? neighbor(tx + 1, ty).data : nullptr;
+            const float* below = ty > 0 ? neighbor(tx, ty - 1).data : nullptr;
+            const float* above = ty + 1 < tilesY ? neighbor(tx, ty + 1).data : nullptr;
+
+            for (int lj = 0; lj < view.height; lj++) {
+                int row = (lj + 1) * PADDED;
+                view.data[row] = left ? left[row + Tile] : view.data[row + 1];
+                view.data[row + view.width + 1] = right ? right[row + 1] : view.data[row + view.width];
+            }
+            float* bottomGhost = view.data + 1;
+            float* topGhost = view.data + (view.height + 1) * PADDED + 1;
+            const float* bottomSource = below ? below + Tile * PADDED + 1 : view.data + PADDED + 1;
+            const float* topSource = above ? above + PADDED + 1 : view.data + view.height * PADDED + 1;
+            std::copy(bottomSource, bottomSource + view.width, bottomGhost);
+            std::copy(topSource, topSource + view.width, topGhost);
+        });
+    }
+
+    // The fluid's setBoundary on the outermost ring of cells: each border cell copies its
+    // inward neighbor, negated on the top/bottom rows (rowSign) or left/right columns
+    // (columnSign), and corners average their two neighbors.
+    void setBorder(float rowSign, float columnSign) {
+        int w = fieldWidth;
+        int h = fieldHeight;
+        for (int i = 1; i < w - 1; i++) {
+            (*this)(i, 0) = rowSign * (*this)(i, 1);
+            (*this)(i, h - 1) = rowSign * (*this)(i, h - 2);
+        }
+        for (int j = 1; j < h - 1; j++) {
+            (*this)(0, j) = columnSign * (*this)(1, j);
+            (*this)(w - 1, j) = columnSign * (*this)(w - 2, j);
+        }
+        (*this)(0, 0) = 0.5f * ((*this)(1, 0) + (*this)(0, 1));
+        (*this)(w - 1, 0) = 0.5f * ((*this)(w - 2, 0) + (*this)(w - 1, 1));
+        (*this)(0, h - 1) = 0.5f * ((*this)(0, h - 2) + (*this)(1, h - 1));
+        (*this)(w - 1, h - 1) = 0.5f * ((*this)(w - 2, h - 1) + (*this)(w - 1, h - 2));
+    }
+
+    // Conversions from and to the flat row-major layout (index i + j * width).
+    void copyFrom(const std::vector<float>& flat) {
+        forEachTile([&](const TileView& view) {
+            for (int lj = 0; lj < view.height; lj++) {
+                const float* source = &flat[view.x0 + (view.y0 + lj) * fieldWidth];
+                std::copy(source, source + view.width, &view.at(0, lj));
+            }
+        });
+    }
+
+    void copyTo(std::vector<float>& flat) {
+        flat.resize(static_cast<size_t>(fieldWidth) * fieldHeight);
+        forEachTile([&](const TileView& view) {
+            for (int lj = 0; lj < view.height; lj++) {
+                const float* source = &view.at(0, lj);
+                std::copy(source, source + view.width, &flat[view.x0 + (view.y0 + lj) * fieldWidth]);
+            }
+        });
+    }
+
+    void swap(Field2D& other) {
+        data.swap(other.data);
+        tileSlot.swap(other.tileSlot);
+        slotTile.swap(other.slotTile);
+        std::swap(fieldWidth, other.fieldWidth);
+        std::swap(fieldHeight, other.fieldHeight);
+        std::swap(tilesX, other.tilesX);
+        std::swap(tilesY, other.tilesY);
+    }
+
+private:
+    std::vector<float> data;
+    std::vector<int> tileSlot; // tile index (tx + ty * tilesX) -> storage slot
+    std::vector<int> slotTile; // storage slot -> tile index
+    int fieldWidth = 0, fieldHeight = 0;
+    int tilesX = 0, tilesY = 0;
+
+    TileView neighbor(int tx, int ty) {
+        return tile(tileSlot[tx + ty * tilesX]);
+    }
+
+    size_t offset(int i, int j) const {
+        int slot = tileSlot[i / Tile + (j / Tile) * tilesX];
+        return static_cast<size_t>(slot) * TILE_CELLS + ((j & (Tile - 1)) + 1) * PADDED + (i & (Tile - 1)) + 1;
+    }
+
+    static uint32_t spreadBits(uint32_t x) {
+        x &= 0x0000ffff;
+        x = (x | (x << 8)) & 0x00ff00ff;
+        x = (x | (x << 4)) & 0x0f0f0f0f;
+        x = (x | (x << 2)) & 0x33333333;
+        x = (x | (x << 1)) & 0x55555555;
+        return x;
+    }
+
+    static uint32_t morton(uint32_t x, uint32_t y) {
+        return spreadBits(x) | (spreadBits(y) << 1);
+    }
+};
+
+#endif
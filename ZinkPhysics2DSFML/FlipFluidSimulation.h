@@ -0,0 +1,320 @@
+#ifndef FLIP_FLUID_SIMULATION_H
+#define FLIP_FLUID_SIMULATION_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <SFML/System/Clock.hpp>
+#include "JobSystem.h"
+#include "PCGSolver.h"
+#include "RenderSnapshot.h"
+#include "FluidSimulation.h"
+
+// FLIP/PIC hybrid on FluidSimulation's collocated grid. Particles carry velocity and
+// density; the grid exists only for gravity and the pressure projection, so the density
+// is moved without the numerical diffusion of semi-Lagrangian advection.
+//
+// Each step splats particles to the grid (bilinear weights to cell centers), projects
+// with the same discretization and PCG solver as FluidSimulation, then updates particle
+// velocities with flipRatio * FLIP (old particle velocity plus the grid change) +
+// (1 - flipRatio) * PIC (the new grid velocity), and moves the particles with RK2.
+//
+// Particle-to-grid runs on fixed particle ranges, one per thread of the job system, each
+// splatting into its own buffer; the buffers are then summed row by row. No atomics, and
+// the result does not depend on how the ranges were scheduled.
+class FlipFluidSimulation {
+public:
+    float flipRatio = 0.95f;
+    float gravity = 9.8f;
+    int particlesPerSide = 2; // particles per cell along each axis
+
+    FlipFluidSimulation(int gridSize)
+        : N(gridSize), u(N* N, 0), v(N* N, 0), uOld(N* N, 0), vOld(N* N, 0),
+        density(N* N, 0), p(N* N, 0), divergence(N* N, 0), solid(N* N, 0) {
+        seedParticles();
+    }
+
+    // Only the particles now inside the obstacle are removed; the rest keep their
+    // velocity and density.
+    void addObstacle(int centerX, int centerY, int radius) {
+        for (int j = centerY - radius; j <= centerY + radius; j++) {
+            for (int i = centerX - radius; i <= centerX + radius; i++) {
+                int dx = i - centerX;
+                int dy = j - centerY;
+                if (i > 0 && i < N - 1 && j > 0 && j < N - 1 && dx * dx + dy * dy <= radius * radius) {
+                    solid[i + j * N] = 1;
+                }
+            }
+        }
+
+        size_t kept = 0;
+        for (size_t k = 0; k < px.size(); k++) {
+            if (solid[int(px[k] + 0.5f) + int(py[k] + 0.5f) * N]) {
+                continue;
+            }
+            px[kept] = px[k];
+            py[kept] = py[k];
+            pu[kept] = pu[k];
+            pv[kept] = pv[k];
+            pd[kept] = pd[k];
+            kept++;
+        }
+        px.resize(kept);
+        py.resize(kept);
+        pu.resize(kept);
+        pv.resize(kept);
+        pd.resize(kept);
+        transferToGrid();
+    }
+
+    // Marks the particles in a rectangle of cells as carrying density.
+    void fillRect(int x0, int y0, int x1, int y1, float amount) {
+        for (size_t k = 0; k < px.size(); k++) {
+            if (px[k] >= x0 && px[k] < x1 && py[k] >= y0 && py[k] < y1) {
+                pd[k] = amount;
+            }
+        }
+        transferToGrid();
+    }
+
+    void update(float timestep) {
+        sf::Clock clock;
+
+        transferToGrid();
+        uOld = u;
+        vOld = v;
+
+        JobSystem::instance().parallelFor(1, N - 1, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 1; i < N - 1; i++) {
+                    v[i + j * N] += gravity * density[i + j * N] * timestep;
+                }
+            }
+        });
+        setBoundary(BOUNDARY_V, v);
+        project();
+
+        transferToParticles();
+        advectParticles(timestep);
+
+        series[FluidSimulation::StepTime].add(clock.getElapsedTime().asSeconds());
+        for (int channel = 0; channel < FluidSimulation::ChannelCount; ++channel) {
+            stepTelemetry[channel] = series[channel].commit();
+        }
+    }
+
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        snapshot.fluidSize = N;
+        snapshot.density.assign(density.begin(), density.end());
+        snapshot.u.assign(u.begin(), u.end());
+        snapshot.v.assign(v.begin(), v.end());
+        snapshot.solid.assign(solid.begin(), solid.end());
+        snapshot.telemetry.assign(stepTelemetry, stepTelemetry + FluidSimulation::ChannelCount);
+    }
+
+    size_t getParticleCount() const {
+        return px.size();
+    }
+
+    PCGSolver& getPCG() {
+        return pcg;
+    }
+
+private:
+    static const int ROW_GRAIN = 16;
+    static const int PARTICLE_GRAIN = 4096;
+    static const int BOUNDARY_SCALAR = FluidSimulation::BOUNDARY_SCALAR;
+    static const int BOUNDARY_U = FluidSimulation::BOUNDARY_U;
+    static const int BOUNDARY_V = FluidSimulation::BOUNDARY_V;
+
+    int N;
+    std::vector<float> u, v, uOld, vOld, density, p, divergence;
+    std::vector<uint8_t> solid;
+    PCGSolver pcg;
+
+    // Particles, one array per attribute.
+    std::vector<float> px, py, pu, pv, pd;
+
+    // Per-thread splat targets: weighted u, v, density and the weight, interleaved per cell.
+    std::vector<std::vector<float>> scatter;
+
+    TelemetrySeries series[FluidSimulation::ChannelCount];
+    TelemetrySample stepTelemetry[FluidSimulation::ChannelCount];
+
+    // Evenly jittered particles in every interior fluid cell, at rest and without density.
+    void seedParticles() {
+        px.clear();
+        py.clear();
+        float spacing = 1.0f / particlesPerSide;
+        uint32_t hash = 12345;
+        for (int j = 1; j < N - 1; j++) {
+            for (int i = 1; i < N - 1; i++) {
+                if (solid[i + j * N]) {
+                    continue;
+                }
+                for (int b = 0; b < particlesPerSide; b++) {
+                    for (int a = 0; a < particlesPerSide; a++) {
+                        hash = hash * 1664525u + 1013904223u;
+                        float jitterX = float(hash >> 8) / 16777216.0f;
+                        hash = hash * 1664525u + 1013904223u;
+                        float jitterY = float(hash >> 8) / 16777216.0f;
+                        // Cell i spans [i - 0.5, i + 0.5) with its center at i.
+                        px.push_back(i - 0.5f + (a + jitterX) * spacing);
+                        py.push_back(j - 0.5f + (b + jitterY) * spacing);
+                    }
+                }
+            }
+        }
+        pu.assign(px.size(), 0.0f);
+        pv.assign(px.size(), 0.0f);
+        pd.assign(px.size(), 0.0f);
+    }
+
+    void setBoundary(int b, std::vector<float>& x) {
+        FluidSimulation::setBoundary(b, x, N);
+    }
+
+    // Bilinear weights of (x, y) over the four surrounding cell centers.
+    struct Stencil {
+        int cell;
+        float w00, w10, w01, w11;
+    };
+
+    Stencil stencilAt(float x, float y) const {
+        x = std::max(0.0f, std::min(x, N - 1.001f));
+        y = std::max(0.0f, std::min(y, N - 1.001f));
+        int i0 = int(x);
+        int j0 = int(y);
+        float s1 = x - i0;
+        float t1 = y - j0;
+        return Stencil{ i0 + j0 * N, (1 - s1) * (1 - t1), s1 * (1 - t1), (1 - s1) * t1, s1 * t1 };
+    }
+
+    float sample(const std::vector<float>& field, const Stencil& s) const {
+        return s.w00 * field[s.cell] + s.w10 * field[s.cell + 1] + s.w01 * field[s.cell + N] + s.w11 * field[s.cell + N + 1];
+    }
+
+    void transferToGrid() {
+        size_t cells = static_cast<size_t>(N) * N;
+        int ranges = int(JobSystem::instance().getConcurrency());
+        scatter.resize(ranges);
+        size_t count = px.size();
+        size_t perRange = (count + ranges - 1) / ranges;
+
+        JobSystem::instance().parallelFor(0, ranges, 1, [&](size_t rangeBegin, size_t rangeEnd) {
+            for (size_t range = rangeBegin; range < rangeEnd; range++) {
+                std::vector<float>& target = scatter[range];
+                target.assign(cells * 4, 0.0f);
+                size_t end = std::min(count, (range + 1) * perRange);
+                for (size_t k = range * perRange; k < end; k++) {
+                    Stencil s = stencilAt(px[k], py[k]);
+                    float values[3] = { pu[k], pv[k], pd[k] };
+                    const int offsets[4] = { 0, 1, N, N + 1 };
+                    const float weights[4] = { s.w00, s.w10, s.w01, s.w11 };
+                    for (int corner = 0; corner < 4; corner++) {
+                        float* cell = &target[(s.cell + offsets[corner]) * 4];
+                        cell[0] += weights[corner] * values[0];
+                        cell[1] += weights[corner] * values[1];
+                        cell[2] += weights[corner] * values[2];
+                        cell[3] += weights[corner];
+                    }
+                }
+            }
+        });
+
+        JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (size_t c = rowBegin * N; c < rowEnd * N; c++) {
+                float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for (int range = 0; range < ranges; range++) {
+                    const float* cell = &scatter[range][c * 4];
+                    sum[0] += cell[0];
+                    sum[1] += cell[1];
+                    sum[2] += cell[2];
+                    sum[3] += cell[3];
+                }
+                float inverse = sum[3] > 0.0f && !solid[c] ? 1.0f / sum[3] : 0.0f;
+                u[c] = sum[0] * inverse;
+                v[c] = sum[1] * inverse;
+                density[c] = sum[2] * inverse;
+            }
+        });
+        setBoundary(BOUNDARY_U, u);
+        setBoundary(BOUNDARY_V, v);
+    }
+
+    // FluidSimulation::project with the conjugate gradient solver.
+    void project() {
+        JobSystem::instance().parallelFor(1, N - 1, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 1; i < N - 1; i++) {
+                    int c = i + j * N;
+                    divergence[c] = -0.5f * (u[c + 1] - u[c - 1] + v[c + N] - v[c - N]);
+                }
+            }
+        });
+        setBoundary(BOUNDARY_SCALAR, divergence);
+        setBoundary(BOUNDARY_SCALAR, p);
+
+        pcg.solve(p, divergence, solid, N);
+        setBoundary(BOUNDARY_SCALAR, p);
+        series[FluidSimulation::PressureIterations].add(float(pcg.getIterations()));
+        series[FluidSimulation::PressureResidual].add(pcg.getResidual());
+
+        JobSystem::instance().parallelFor(1, N - 1, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 1; i < N - 1; i++) {
+                    int c = i + j * N;
+                    if (solid[c]) {
+                        continue;
+                    }
+                    float right = solid[c + 1] ? p[c] : p[c + 1];
+                    float left = solid[c - 1] ? p[c] : p[c - 1];
+                    float up = solid[c + N] ? p[c] : p[c + N];
+                    float down = solid[c - N] ? p[c] : p[c - N];
+                    u[c] -= 0.5f * (right - left);
+                    v[c] -= 0.5f * (up - down);
+                }
+            }
+        });
+        setBoundary(BOUNDARY_U, u);
+        setBoundary(BOUNDARY_V, v);
+    }
+
+    void transferToParticles() {
+        JobSystem::instance().parallelFor(0, px.size(), PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                Stencil s = stencilAt(px[k], py[k]);
+                float gridU = sample(u, s);
+                float gridV = sample(v, s);
+                float flipU = pu[k] + gridU - sample(uOld, s);
+                float flipV = pv[k] + gridV - sample(vOld, s);
+                pu[k] = flipRatio * flipU + (1.0f - flipRatio) * gridU;
+                pv[k] = flipRatio * flipV + (1.0f - flipRatio) * gridV;
+            }
+        });
+    }
+
+    // Midpoint RK2 through the projected grid velocity. A particle that would end up in
+    // a solid cell stays where it was.
+    void advectParticles(float dt) {
+        float lo = 0.5f;
+        float hi = N - 1.5f;
+        JobSystem::instance().parallelFor(0, px.size(), PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                Stencil start = stencilAt(px[k], py[k]);
+                float midX = px[k] + 0.5f * dt * sample(u, start);
+                float midY = py[k] + 0.5f * dt * sample(v, start);
+                Stencil middle = stencilAt(midX, midY);
+                float x = std::max(lo, std::min(px[k] + dt * sample(u, middle), hi));
+                float y = std::max(lo, std::min(py[k] + dt * sample(v, middle), hi));
+                if (!solid[int(x + 0.5f) + int(y + 0.5f) * N]) {
+                    px[k] = x;
+                    py[k] = y;
+                }
+            }
+        });
+    }
+};
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef FLUID_RENDERER_H
+#define FLUID_RENDERER_H
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "RenderSnapshot.h"
+#include "JobSystem.h"
+#include "FluidSimulation.h"
+#include "Charts.h"
+
+// Maps a fluid field through a 256-entry colormap into a pixel buffer that lives as
+// long as the renderer, uploads it with one texture update and draws it as a single
+// smoothed sprite stretched over the window.
+class FluidRenderer {
+public:
+    enum class Field { Density, Speed };
+
+    Field field = Field::Density;
+    float densityScale = 1.0f;
+    float speedScale = 0.05f;
+
+    FluidRenderer()
+        : iterationChart(10, 30, 200, 100, "Pressure Iterations", sf::Color::Blue),
+        residualChart(220, 30, 200, 100, "Pressure Residual (-log10 x20)", sf::Color::Red),
+        stepTimeChart(430, 30, 200, 100, "Step Time (ms)", sf::Color::Green),
+        trafficChart(10, 140, 200, 100, "Pass Traffic (bytes/cell)", sf::Color::Magenta) {
+        for (int i = 0; i < 256; ++i) {
+            float t = i / 255.0f;
+            // Density: white to deep blue, so empty cells blend with the background.
+            densityColors[i] = sf::Color(
+                static_cast<sf::Uint8>(255 * (1.0f - t)),
+                static_cast<sf::Uint8>(255 * (1.0f - 0.8f * t)),
+                static_cast<sf::Uint8>(255 - 100 * t * t));
+            // Speed: black, red, yellow, white.
+            speedColors[i] = sf::Color(
+                static_cast<sf::Uint8>(255 * std::min(1.0f, 3.0f * t)),
+                static_cast<sf::Uint8>(255 * std::min(1.0f, std::max(0.0f, 3.0f * t - 1.0f))),
+                static_cast<sf::Uint8>(255 * std::max(0.0f, 3.0f * t - 2.0f)));
+        }
+    }
+
+    void toggleField() {
+        field = field == Field::Density ? Field::Speed : Field::Density;
+    }
+
+    void render(sf::RenderWindow& window, const RenderSnapshot& snapshot, bool fresh) {
+        int N = snapshot.fluidSize;
+        if (N <= 0) {
+            return;
+        }
+
+        if (N != size) {
+            size = N;
+            pixels.assign(static_cast<size_t>(N) * N * 4, 0);
+            texture.create(N, N);
+            texture.setSmooth(true);
+            sprite.setTexture(texture, true);
+            fresh = true;
+        }
+
+        if (fresh || field != uploadedField) {
+            fillPixels(snapshot);
+            texture.update(pixels.data());
+            uploadedField = field;
+        }
+
+        sprite.setScale(static_cast<float>(window.getSize().x) / N, static_cast<float>(window.getSize().y) / N);
+        window.draw(sprite);
+
+        if (fresh && snapshot.telemetry.size() == FluidSimulation::ChannelCount) {
+            iterationChart.addSample(snapshot.telemetry[FluidSimulation::PressureIterations]);
+            residualChart.addData(residualHeight(snapshot.telemetry[FluidSimulation::PressureResidual].max));
+            stepTimeChart.addData(snapshot.telemetry[FluidSimulation::StepTime].mean * 1000.0f);
+            trafficChart.addSample(snapshot.telemetry[FluidSimulation::PassBytes]);
+        }
+        iterationChart.draw(window);
+        residualChart.draw(window);
+        stepTimeChart.draw(window);
+        trafficChart.draw(window);
+    }
+
+private:
+    sf::Color densityColors[256];
+    sf::Color speedColors[256];
+    sf::Color solidColor = sf::Color(90, 90, 90);
+    std::vector<sf::Uint8> pixels;
+    sf::Texture texture;
+    sf::Sprite sprite;
+    int size = 0;
+    Field uploadedField = Field::Density;
+    Chart iterationChart, residualChart, stepTimeChart, trafficChart;
+
+    // Residuals span orders of magnitude, so the chart shows digits of accuracy.
+    static float residualHeight(float residual) {
+        return residual > 0.0f ? std::max(0.0f, -std::log10(residual) * 20.0f) : 0.0f;
+    }
+
+    static int lutIndex(float value) {
+        return static_cast<int>(std::min(std::max(value, 0.0f), 1.0f) * 255.0f);
+    }
+
+    void fillPixels(const RenderSnapshot& snapshot) {
+        int N = size;
+        bool speed = field == Field::Speed && snapshot.u.size() == pixels.size() / 4;
+        bool solids = snapshot.solid.size() == pixels.size() / 4;
+
+        JobSystem::instance().parallelFor(0, N, 16, [&](size_t rowBegin, size_t rowEnd) {
+            for (size_t j = rowBegin; j < rowEnd; j++) {
+                for (int i = 0; i < N; i++) {
+                    size_t cell = i + j * N;
+                    sf::Color color;
+                    if (solids && snapshot.solid[cell]) {
+                        color = solidColor;
+                    }
+                    else if (speed) {
+                        float magnitude = std::sqrt(snapshot.u[cell] * snapshot.u[cell] + snapshot.v[cell] * snapshot.v[cell]);
+                        color = speedColors[lutIndex(magnitude * speedScale)];
+                    }
+                    else {
+                        color = densityColors[lutIndex(snapshot.density[cell] * densityScale)];
+                    }
+
+                    sf::Uint8* pixel = &pixels[cell * 4];
+                    pixel[0] = color.r;
+                    pixel[1] = color.g;
+                    pixel[2] = color.b;
+                    pixel[3] = 255;
+                }
+            }
+        });
+    }
+};
+
+#endif
@@ -4,19 +4,149 @@
 #include <vector>
 #include <SFML/Graphics.hpp>
 #include <algorithm>
+#include "JobSystem.h"
+#include "RenderSnapshot.h"
+#include "MultigridSolver.h"
+#include "PCGSolver.h"
+#include "RelaxationSolver.h"
+#include "AdvectionKernel.h"
 
 class FluidSimulation {
 private:
+    static const int ROW_GRAIN = 16;
+
     int N;
     float dt, viscosity;
     std::vector<float> u, v, u_prev, v_prev;
+    std::vector<float> p, divergence, pressureImpulse;
     std::vector<float> density, density_prev;
+    std::vector<uint8_t> solid;
+    std::vector<float> solidU, solidV;
+    std::vector<int> solidCells;
+    bool hasObstacles = false;
+    bool solidCellsDirty = false;
+    float passBytes = 0.0f;
+    MultigridSolver multigrid;
+    PCGSolver pcg;
+    RelaxationSolver relaxation;
+    AdvectionKernel advector;
 
 public:
+    // setBoundary flips rows for b == 1 and columns for b == 2, so with x = i and
+    // y = j the horizontal velocity u uses 2 and the vertical velocity v uses 1.
+    static const int BOUNDARY_SCALAR = 0;
+    static const int BOUNDARY_V = 1;
+    static const int BOUNDARY_U = 2;
+
+    enum class PressureSolver {
+        GaussSeidel,      // solverIterations red-black sweeps of linearSolve
+        Multigrid,        // cycles until the residual tolerance is met
+        ConjugateGradient // PCG over fluid cells only, the one that respects obstacles
+    };
+
+    // PassBytes is the memory traffic per cell per step of every pass outside the linear
+    // solvers: forces, copies, advection, divergence and gradient. It counts each array a
+    // pass streams through once, reads and writes separately, and ignores the edge-only
+    // boundary passes; the solvers report their own cost as iterations.
+    enum TelemetryChannel { PressureIterations, PressureResidual, StepTime, PassBytes, ChannelCount };
+
+    PressureSolver pressureSolver = PressureSolver::ConjugateGradient;
+    float diffusion = 0.0f;
+    float gravity = 9.8f;
+    int solverIterations = 20;
+    bool fusedStep = true;               // fusedUpdate() instead of velocityStep() + densityStep()
+    bool recordPressureImpulse = false;  // fill getPressureImpulse(); costs two more arrays per projection
+
     FluidSimulation(int gridSize, float timeStep, float vis)
         : N(gridSize), dt(timeStep), viscosity(vis),
         u(N* N, 0), v(N* N, 0), u_prev(N* N, 0), v_prev(N* N, 0),
-        density(N* N, 0), density_prev(N* N, 0) {
+        p(N* N, 0), divergence(N* N, 0), pressureImpulse(N* N, 0),
+        density(N* N, 0), density_prev(N* N, 0), solid(N* N, 0), solidU(N* N, 0), solidV(N* N, 0) {
+    }
+
+    // Solid cells are walls inside the domain: no flow enters them and, with the
+    // conjugate gradient solver, pressure sees them as zero-gradient boundaries.
+    void setSolid(int i, int j, bool isSolid) {
+        if (i > 0 && i < N - 1 && j > 0 && j < N - 1) {
+            uint8_t value = isSolid ? 1 : 0;
+            solidCellsDirty = solidCellsDirty || solid[i + j * N] != value;
+            solid[i + j * N] = value;
+            hasObstacles = hasObstacles || isSolid;
+        }
+    }
+
+    // Velocity a solid cell moves with, in cells per second. The projection holds the
+    // cell at it, so the fluid next to a moving body is pushed along instead of stopped.
+    void setSolidVelocity(int i, int j, float su, float sv) {
+        if (i > 0 && i < N - 1 && j > 0 && j < N - 1) {
+            solidU[i + j * N] = su;
+            solidV[i + j * N] = sv;
+        }
+    }
+
+    void fillRect(int x0, int y0, int x1, int y1, float amount) {
+        for (int j = std::max(y0, 0); j < std::min(y1, N); j++) {
+            for (int i = std::max(x0, 0); i < std::min(x1, N); i++) {
+                density[i + j * N] = amount;
+            }
+        }
+    }
+
+    void addObstacle(int centerX, int centerY, int radius) {
+        for (int j = centerY - radius; j <= centerY + radius; j++) {
+            for (int i = centerX - radius; i <= centerX + radius; i++) {
+                int dx = i - centerX;
+                int dy = j - centerY;
+                if (dx * dx + dy * dy <= radius * radius) {
+                    setSolid(i, j, true);
+                }
+            }
+        }
+    }
+
+    void clearObstacles() {
+        std::fill(solid.begin(), solid.end(), 0);
+        std::fill(solidU.begin(), solidU.end(), 0.0f);
+        std::fill(solidV.begin(), solidV.end(), 0.0f);
+        solidCells.clear();
+        hasObstacles = false;
+        solidCellsDirty = false;
+    }
+
+    bool isSolid(int i, int j) const {
+        return solid[i + j * N] != 0;
+    }
+
+    int getSize() const {
+        return N;
+    }
+
+    const std::vector<float>& getU() const {
+        return u;
+    }
+
+    const std::vector<float>& getV() const {
+        return v;
+    }
+
+    const std::vector<float>& getDensity() const {
+        return density;
+    }
+
+    std::vector<float>& getDensity() {
+        return density;
+    }
+
+    // Sum of the pressures both projections of the last step applied, if
+    // recordPressureImpulse is set. Its gradient is the velocity change pressure caused
+    // over the step, in cells per second.
+    const std::vector<float>& getPressureImpulse() const {
+        return pressureImpulse;
+    }
+
+    void cyclePressureSolver() {
+        pressureSolver = pressureSolver == PressureSolver::GaussSeidel ? PressureSolver::Multigrid :
+            pressureSolver == PressureSolver::Multigrid ? PressureSolver::ConjugateGradient : PressureSolver::GaussSeidel;
     }
 
     void addSource(std::vector<float>& x, const std::vector<float>& s, float dt) {
@@ -26,70 +156,292 @@ public:
     }
 
     void setBoundary(int b, std::vector<float>& x) {
+        setBoundary(b, x, N);
+    }
+
+    // For any collocated N x N grid, so other grid solvers share the same walls.
+    static void setBoundary(int b, std::vector<float>& x, int N) {
         for (int i = 1; i < N - 1; i++) {
             x[i] = b == 1 ? -x[i + N] : x[i + N];
             x[i + (N - 1) * N] = b == 1 ? -x[i + (N - 2) * N] : x[i + (N - 2) * N];
         }
 
         for (int i = 1; i < N - 1; i++) {
-            x[i * N] = b == 2 ? -x[(i + 1) * N] : x[(i + 1) * N];
-            x[i * N + (N - 1)] = b == 2 ? -x[(i + 1) * N + (N - 2)] : x[(i + 1) * N + (N - 2)];
+            x[i * N] = b == 2 ? -x[i * N + 1] : x[i * N + 1];
+            x[i * N + (N - 1)] = b == 2 ? -x[i * N + (N - 2)] : x[i * N + (N - 2)];
         }
+
+        x[0] = 0.5f * (x[1] + x[N]);
+        x[N - 1] = 0.5f * (x[N - 2] + x[2 * N - 1]);
+        x[(N - 1) * N] = 0.5f * (x[(N - 2) * N] + x[(N - 1) * N + 1]);
+        x[N * N - 1] = 0.5f * (x[N * N - 2] + x[(N - 1) * N - 1]);
     }
 
-    void applyGravity(std::vector<float>& v, float gravity, float dt) {
-        for (int i = 0; i < N; i++) {
-            for (int j = 0; j < N; j++) {
-                v[i + j * N] += gravity * dt;
+    // Gravity scaled by the local density, so heavy fluid sinks through the light
+    // background instead of being cancelled as a uniform gradient by the projection.
+    void applyGravity(std::vector<float>& v, const std::vector<float>& density, float gravity, float dt) {
+        passBytes += 12.0f;
+        JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 0; i < N; i++) {
+                    v[i + j * N] += gravity * density[i + j * N] * dt;
+                }
             }
+        });
+    }
+
+    void linearSolve(int b, std::vector<float>& x, const std::vector<float>& x0, float a, float c) {
+        if (relaxation.method == RelaxationSolver::Method::TiledJacobi) {
+            relaxation.solveTiled(x, x0, a, c, N, solverIterations, b == 1 ? -1.0f : 1.0f, b == 2 ? -1.0f : 1.0f);
+            return;
         }
+        relaxation.solve(x, x0, a, c, N, solverIterations, [&]() { setBoundary(b, x); });
     }
 
-    void advect(std::vector<float>& d, std::vector<float>& d0, std::vector<float>& u, std::vector<float>& v, float dt) {
-        for (int i = 1; i < N - 1; i++) {
-            for (int j = 1; j < N - 1; j++) {
-                float x = i - dt * u[i + j * N];
-                float y = j - dt * v[i + j * N];
+    // diff is in cells^2 per second, the unit advection and projection already work in,
+    // so a viscosity means the same thing at every grid size.
+    void diffuse(int b, std::vector<float>& x, const std::vector<float>& x0, float diff, float dt) {
+        float a = dt * diff;
+        if (a <= 0.0f) {
+            std::copy(x0.begin(), x0.end(), x.begin());
+            passBytes += 8.0f;
+            return;
+        }
+        linearSolve(b, x, x0, a, 1 + 4 * a);
+    }
+
+    // Removes the divergent part of (u, v) so the velocity field stays mass conserving.
+    // Gauss-Seidel starts from zero every time; the other solvers warm start from the
+    // previous projection's pressure, which is usually within a few percent already.
+    void project(std::vector<float>& u, std::vector<float>& v) {
+        if (hasObstacles) {
+            imposeSolidVelocity(u, v);
+        }
 
-                x = std::max(0.5f, std::min(x, float(N - 1.5f)));
-                y = std::max(0.5f, std::min(y, float(N - 1.5f)));
+        bool warmStart = pressureSolver != PressureSolver::GaussSeidel;
+        passBytes += warmStart ? 12.0f : 16.0f;
+        JobSystem::instance().parallelFor(1, N - 1, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 1; i < N - 1; i++) {
+                    divergence[i + j * N] = -0.5f * (u[i + 1 + j * N] - u[i - 1 + j * N] +
+                        v[i + (j + 1) * N] - v[i + (j - 1) * N]);
+                    if (!warmStart) {
+                        p[i + j * N] = 0;
+                    }
+                }
+            }
+        });
+        setBoundary(BOUNDARY_SCALAR, divergence);
+        setBoundary(BOUNDARY_SCALAR, p);
 
-                int i0 = int(x);
-                int j0 = int(y);
-                int i1 = i0 + 1;
-                int j1 = j0 + 1;
+        solvePressure();
 
-                float s1 = x - i0;
-                float s0 = 1.0f - s1;
-                float t1 = y - j0;
-                float t0 = 1.0f - t1;
+        // u and v read and written, p and the solid mask read.
+        passBytes += recordPressureImpulse ? 29.0f : 21.0f;
+        JobSystem::instance().parallelFor(1, N - 1, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 1; i < N - 1; i++) {
+                    int c = i + j * N;
+                    if (solid[c]) {
+                        continue;
+                    }
+                    // A solid neighbor mirrors this cell's pressure: no gradient into the wall.
+                    float right = solid[c + 1] ? p[c] : p[c + 1];
+                    float left = solid[c - 1] ? p[c] : p[c - 1];
+                    float up = solid[c + N] ? p[c] : p[c + N];
+                    float down = solid[c - N] ? p[c] : p[c - N];
+                    u[c] -= 0.5f * (right - left);
+                    v[c] -= 0.5f * (up - down);
+                    if (recordPressureImpulse) {
+                        pressureImpulse[c] += p[c];
+                    }
+                }
+            }
+        });
+        setBoundary(BOUNDARY_U, u);
+        setBoundary(BOUNDARY_V, v);
+    }
 
-                d[i + j * N] = s0 * (t0 * d0[i0 + j0 * N] + t1 * d0[i0 + j1 * N]) +
-                    s1 * (t0 * d0[i1 + j0 * N] + t1 * d0[i1 + j1 * N]);
+    void imposeSolidVelocity(std::vector<float>& u, std::vector<float>& v) {
+        for (int c : getSolidCells()) {
+            u[c] = solidU[c];
+            v[c] = solidV[c];
+        }
+    }
+
+    void clearSolidCells(std::vector<float>& x) {
+        for (int c : getSolidCells()) {
+            x[c] = 0.0f;
+        }
+    }
+
+    // Indices of the solid cells, rebuilt with one pass over the mask after it changes,
+    // so the per-step solid passes only touch the obstacles themselves.
+    const std::vector<int>& getSolidCells() {
+        if (solidCellsDirty) {
+            solidCells.clear();
+            for (int c = 0; c < N * N; c++) {
+                if (solid[c]) {
+                    solidCells.push_back(c);
+                }
             }
+            solidCellsDirty = false;
+            passBytes += 1.0f;
         }
+        return solidCells;
+    }
+
+    void solvePressure() {
+        if (pressureSolver == PressureSolver::ConjugateGradient) {
+            pcg.solve(p, divergence, solid, N);
+            setBoundary(BOUNDARY_SCALAR, p);
+            series[PressureIterations].add(float(pcg.getIterations()));
+            series[PressureResidual].add(pcg.getResidual());
+        }
+        else if (pressureSolver == PressureSolver::Multigrid) {
+            multigrid.solve(p, divergence, N);
+            setBoundary(BOUNDARY_SCALAR, p);
+            series[PressureIterations].add(float(multigrid.getCycles()));
+            series[PressureResidual].add(multigrid.getResidual());
+        }
+        else {
+            linearSolve(BOUNDARY_SCALAR, p, divergence, 1, 4);
+            series[PressureIterations].add(float(solverIterations));
+        }
+    }
+
+    MultigridSolver& getMultigrid() {
+        return multigrid;
+    }
+
+    PCGSolver& getPCG() {
+        return pcg;
+    }
+
+    RelaxationSolver& getRelaxation() {
+        return relaxation;
+    }
+
+    void advect(int b, std::vector<float>& d, const std::vector<float>& d0, const std::vector<float>& u, const std::vector<float>& v, float dt) {
+        passBytes += 16.0f;
+        float* destination[] = { d.data() };
+        const float* source[] = { d0.data() };
+        advector.advect(1, destination, source, u.data(), v.data(), dt, N);
+        setBoundary(b, d);
+    }
+
+    // Both velocity components ride the same backtrace, so it is computed once per cell.
+    void advectVelocity(float dt) {
+        passBytes += 16.0f;
+        float* destination[] = { u.data(), v.data() };
+        const float* source[] = { u_prev.data(), v_prev.data() };
+        advector.advect(2, destination, source, u_prev.data(), v_prev.data(), dt, N);
+        setBoundary(BOUNDARY_U, u);
+        setBoundary(BOUNDARY_V, v);
     }
 
+    // Stable Fluids: forces, diffuse, project, self-advect, project, then scalars.
+    // Every stage writes into the buffer it swapped out, so nothing is copied or allocated.
     void update(float timestep) {
-        density_prev = density;
+        sf::Clock clock;
+        passBytes = 0.0f;
+        if (recordPressureImpulse) {
+            std::fill(pressureImpulse.begin(), pressureImpulse.end(), 0.0f);
+            passBytes += 4.0f;
+        }
 
-        applyGravity(v, 9.8f, timestep);
+        if (fusedStep) {
+            fusedUpdate(timestep);
+        }
+        else {
+            velocityStep(timestep);
+            densityStep(timestep);
+        }
 
-        advect(density, density_prev, u, v, timestep);
+        series[PassBytes].add(passBytes);
+        series[StepTime].add(clock.getElapsedTime().asSeconds());
+        for (int channel = 0; channel < ChannelCount; ++channel) {
+            stepTelemetry[channel] = series[channel].commit();
+        }
     }
 
-    void render(sf::RenderWindow& window) {
-        sf::VertexArray pixels(sf::Points, N * N);
-        for (int i = 0; i < N; i++) {
-            for (int j = 0; j < N; j++) {
-                float d = density[i + j * N] * 255;
-                sf::Color color(0, 0, d);
+    void velocityStep(float timestep) {
+        applyGravity(v, density, gravity, timestep);
+
+        std::swap(u, u_prev);
+        diffuse(BOUNDARY_U, u, u_prev, viscosity, timestep);
+        std::swap(v, v_prev);
+        diffuse(BOUNDARY_V, v, v_prev, viscosity, timestep);
+        project(u, v);
 
-                pixels[i + j * N].position = sf::Vector2f(i * 10, j * 10);
-                pixels[i + j * N].color = color;
+        std::swap(u, u_prev);
+        std::swap(v, v_prev);
+        advectVelocity(timestep);
+        project(u, v);
+    }
+
+    void densityStep(float timestep) {
+        std::swap(density, density_prev);
+        diffuse(BOUNDARY_SCALAR, density, density_prev, diffusion, timestep);
+        std::swap(density, density_prev);
+        advect(BOUNDARY_SCALAR, density, density_prev, u, v, timestep);
+        if (hasObstacles) {
+            clearSolidCells(density);
+        }
+    }
+
+    // The same stages in fewer sweeps. u, v and the density ride one backtrace through
+    // the velocity of the first projection, and gravity is added to each advected row
+    // while it is still in cache. Zero diffusion skips its copy instead of making one.
+    // Gravity now lands before the second projection instead of the first, and the
+    // density moves with the start-of-step velocity instead of the final one; both
+    // projections still see every force, so the flow is the same to first order.
+    void fusedUpdate(float timestep) {
+        if (viscosity > 0.0f) {
+            std::swap(u, u_prev);
+            diffuse(BOUNDARY_U, u, u_prev, viscosity, timestep);
+            std::swap(v, v_prev);
+            diffuse(BOUNDARY_V, v, v_prev, viscosity, timestep);
+        }
+        project(u, v);
+
+        std::swap(u, u_prev);
+        std::swap(v, v_prev);
+        if (diffusion > 0.0f) {
+            diffuse(BOUNDARY_SCALAR, density_prev, density, diffusion, timestep);
+        }
+        else {
+            std::swap(density, density_prev);
+        }
+
+        // Three sources read, three results written.
+        passBytes += 24.0f;
+        float* destination[] = { u.data(), v.data(), density.data() };
+        const float* source[] = { u_prev.data(), v_prev.data(), density_prev.data() };
+        advector.advect(3, destination, source, u_prev.data(), v_prev.data(), timestep, N, [&](int j) {
+            float* row = &v[j * N];
+            const float* weight = &density[j * N];
+            for (int i = 1; i < N - 1; i++) {
+                row[i] += gravity * weight[i] * timestep;
             }
+        });
+        setBoundary(BOUNDARY_U, u);
+        setBoundary(BOUNDARY_V, v);
+        setBoundary(BOUNDARY_SCALAR, density);
+
+        project(u, v);
+        if (hasObstacles) {
+            clearSolidCells(density);
         }
-        window.draw(pixels);
+    }
+
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        snapshot.fluidSize = N;
+        snapshot.density.assign(density.begin(), density.end());
+        snapshot.u.assign(u.begin(), u.end());
+        snapshot.v.assign(v.begin(), v.end());
+        snapshot.solid.assign(solid.begin(), solid.end());
+        snapshot.telemetry.assign(stepTelemetry, stepTelemetry + ChannelCount);
     }
 
     void addFluidSource(int xStart, int yStart, float amount) {
@@ -121,6 +473,10 @@ public:
 
         setBoundary(2, density);
     }
+
+private:
+    TelemetrySeries series[ChannelCount];
+    TelemetrySample stepTelemetry[ChannelCount];
 };
 
 #endif
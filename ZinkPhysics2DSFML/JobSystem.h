@@ -0,0 +1,275 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <algorithm>
+
+// Counts outstanding tasks so a caller can wait for a batch to finish.
+class TaskGroup {
+public:
+    TaskGroup() : remaining(0) {}
+
+    bool done() const {
+        return remaining.load(std::memory_order_acquire) == 0;
+    }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> remaining;
+};
+
+// One scheduler shared by every subsystem. Each worker owns a deque: it pushes and
+// pops at the back, idle workers steal from the front of the others. Threads that are
+// not workers (the render/main thread) submit into their own slot and execute tasks
+// while they wait, so waiting on a parallel_for never leaves a core idle.
+class JobSystem {
+public:
+    explicit JobSystem(unsigned int workerCount = defaultWorkerCount())
+        : queues(workerCount + 1), running(true), pending(0) {
+        for (auto& queue : queues) {
+            queue.reset(new WorkQueue());
+        }
+        for (unsigned int i = 0; i < workerCount; ++i) {
+            workers.emplace_back([this, i]() { workerLoop(i); });
+        }
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex);
+            running = false;
+        }
+        sleepCondition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    static JobSystem& instance() {
+        static JobSystem jobs;
+        return jobs;
+    }
+
+    static unsigned int defaultWorkerCount() {
+        unsigned int cores = std::thread::hardware_concurrency();
+        return cores > 1 ? cores - 1 : 0;
+    }
+
+    unsigned int getWorkerCount() const {
+        return static_cast<unsigned int>(workers.size());
+    }
+
+    // Worker threads plus the calling thread.
+    unsigned int getConcurrency() const {
+        return getWorkerCount() + 1;
+    }
+
+    void submit(TaskGroup& group, std::function<void()> task) {
+        group.remaining.fetch_add(1, std::memory_order_relaxed);
+        WorkQueue& queue = *queues[currentSlot()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.tasks.push_back(Task{ std::move(task), &group });
+        }
+        pending.fetch_add(1, std::memory_order_release);
+        {
+            // Pairs with the predicate check in workerLoop so the wakeup is not lost.
+            std::lock_guard<std::mutex> lock(sleepMutex);
+        }
+        sleepCondition.notify_one();
+    }
+
+    // Runs queued tasks on the calling thread until the group has drained.
+    void wait(TaskGroup& group) {
+        while (!group.done()) {
+            if (!runOne()) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    // Executes at most one queued task on the calling thread. The render loop can call
+    // this between frames to lend its core to the simulation.
+    bool runOne() {
+        Task task;
+        if (!take(currentSlot(), task)) {
+            return false;
+        }
+        execute(task);
+        return true;
+    }
+
+    // Calls body(begin, end) over sub-ranges of [begin, end), at least grain items each.
+    template <typename Body>
+    void parallelFor(size_t begin, size_t end, size_t grain, Body&& body) {
+        if (end <= begin) {
+            return;
+        }
+
+        size_t count = end - begin;
+        grain = std::max<size_t>(grain, 1);
+        size_t maxChunks = static_cast<size_t>(getConcurrency()) * 4;
+        size_t chunks = std::min(maxChunks, (count + grain - 1) / grain);
+        if (chunks <= 1 || workers.empty()) {
+            body(begin, end);
+            return;
+        }
+
+        size_t chunkSize = (count + chunks - 1) / chunks;
+        TaskGroup group;
+        for (size_t chunkBegin = begin + chunkSize; chunkBegin < end; chunkBegin += chunkSize) {
+            size_t chunkEnd = std::min(chunkBegin + chunkSize, end);
+            submit(group, [&body, chunkBegin, chunkEnd]() { body(chunkBegin, chunkEnd); });
+        }
+        body(begin, std::min(begin + chunkSize, end));
+        wait(group);
+    }
+
+private:
+    struct Task {
+        std::function<void()> function;
+        TaskGroup* group = nullptr;
+    };
+
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    bool running;
+    std::atomic<int> pending;
+
+    struct ThreadSlot {
+        const JobSystem* owner = nullptr;
+        size_t index = 0;
+    };
+
+    static ThreadSlot& threadSlot() {
+        static thread_local ThreadSlot slot;
+        return slot;
+    }
+
+    // Workers use their own deque; any other thread shares the last one.
+    size_t currentSlot() const {
+        const ThreadSlot& slot = threadSlot();
+        return slot.owner == this ? slot.index : queues.size() - 1;
+    }
+
+    bool take(size_t slot, Task& task) {
+        {
+            WorkQueue& own = *queues[slot];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+
+        for (size_t offset = 1; offset < queues.size(); ++offset) {
+            WorkQueue& victim = *queues[(slot + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                pending.fetch_sub(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void execute(Task& task) {
+        task.function();
+        task.group->remaining.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    void workerLoop(unsigned int index) {
+        threadSlot().owner = this;
+        threadSlot().index = index;
+        while (true) {
+            Task task;
+            if (take(index, task)) {
+                execute(task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCondition.wait(lock, [this]() {
+                return !running || pending.load(std::memory_order_acquire) > 0;
+            });
+            if (!running) {
+                return;
+            }
+        }
+    }
+};
+
+// Static dependency graph of tasks. Nodes become ready when all their predecessors
+// have finished and are then handed to the JobSystem.
+class TaskGraph {
+public:
+    int add(std::function<void()> function) {
+        nodes.emplace_back(new Node());
+        nodes.back()->function = std::move(function);
+        return static_cast<int>(nodes.size()) - 1;
+    }
+
+    // `before` must finish before `after` starts.
+    void precede(int before, int after) {
+        nodes[before]->successors.push_back(after);
+        nodes[after]->dependencyCount++;
+    }
+
+    void run(JobSystem& jobs) {
+        TaskGroup group;
+        for (auto& node : nodes) {
+            node->remaining.store(node->dependencyCount, std::memory_order_relaxed);
+        }
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (nodes[i]->dependencyCount == 0) {
+                schedule(jobs, group, static_cast<int>(i));
+            }
+        }
+        jobs.wait(group);
+    }
+
+private:
+    struct Node {
+        std::function<void()> function;
+        std::vector<int> successors;
+        int dependencyCount = 0;
+        std::atomic<int> remaining{ 0 };
+    };
+
+    std::vector<std::unique_ptr<Node>> nodes;
+
+    void schedule(JobSystem& jobs, TaskGroup& group, int index) {
+        jobs.submit(group, [this, &jobs, &group, index]() {
+            Node& node = *nodes[index];
+            node.function();
+            for (int successor : node.successors) {
+                if (nodes[successor]->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                    schedule(jobs, group, successor);
+                }
+            }
+        });
+    }
+};
+
+#endif
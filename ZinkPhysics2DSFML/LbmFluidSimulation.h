@@ -0,0 +1,423 @@
+#ifndef LBM_FLUID_SIMULATION_H
+#define LBM_FLUID_SIMULATION_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <SFML/System/Clock.hpp>
+#include "JobSystem.h"
+#include "RenderSnapshot.h"
+#include "FluidSimulation.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define LBM_AVX2 1
+#endif
+
+// D2Q9 lattice Boltzmann channel flow with BGK collision, in lattice units: every update()
+// advances stepsPerUpdate lattice steps, each a single fused stream-collide sweep. Fluid
+// enters at inletVelocity through the left column, a regularized velocity boundary, and leaves
+// through the right one, where populations arriving from outside the grid are copied
+// from the column before it (zero gradient). The top and bottom of the grid and the
+// obstacles are no-slip half-way bounce-back.
+//
+// The populations use the AA pattern (Bailey et al. 2009), so there is one copy of them
+// and each step reads and writes 9 floats per cell in place. Even steps read a cell's own
+// populations and store the post-collision ones in the opposite slots; odd steps gather
+// from the neighbors and scatter back to them. An odd step writes exactly the locations
+// it read, so rows can be processed in any order on any thread.
+//
+// Obstacles are a bitmask, one bit per cell. Blocks of eight cells away from every solid
+// and the grid edge take the AVX2 path; the rest, including the inlet and outlet columns,
+// go through the scalar cell update, which handles bounce-back. Both do their arithmetic
+// in the same order, so the AVX2 and scalar builds step to the same bits.
+//
+// The column before the outlet is rewritten in place during a step, so the outlet keeps
+// what it needs from last step in a small side array, one per step parity.
+class LbmFluidSimulation {
+public:
+    float inletVelocity = 0.08f; // lattice cells per step
+    int stepsPerUpdate = 20;
+
+    // viscosity is kinematic, in lattice units; it sets the BGK relaxation rate.
+    LbmFluidSimulation(int gridSize, float viscosity)
+        : N(gridSize), wordsPerRow((gridSize + 63) / 64), solidBits(static_cast<size_t>(wordsPerRow) * gridSize, 0),
+        populations(static_cast<size_t>(Q) * gridSize * gridSize), u(gridSize * gridSize, 0.0f), v(gridSize * gridSize, 0.0f) {
+        outletPopulations[0].resize(OUTLET_DIRECTIONS * gridSize);
+        outletPopulations[1].resize(OUTLET_DIRECTIONS * gridSize);
+        omega = 1.0f / (3.0f * viscosity + 0.5f);
+        reset();
+    }
+
+    void addObstacle(int centerX, int centerY, int radius) {
+        for (int j = centerY - radius; j <= centerY + radius; j++) {
+            for (int i = centerX - radius; i <= centerX + radius; i++) {
+                int dx = i - centerX;
+                int dy = j - centerY;
+                if (i > 0 && i < N - 1 && j >= 0 && j < N && dx * dx + dy * dy <= radius * radius) {
+                    solidBits[j * wordsPerRow + i / 64] |= uint64_t(1) << (i % 64);
+                }
+            }
+        }
+        reset();
+    }
+
+    // Uniform flow at the inlet velocity everywhere, in the layout an even step reads.
+    void reset() {
+        float feq[Q];
+        equilibrium(1.0f, inletVelocity, 0.0f, feq);
+        for (int cell = 0; cell < N * N; cell++) {
+            bool blocked = isSolid(cell % N, cell / N);
+            for (int q = 0; q < Q; q++) {
+                populations[q * N * N + cell] = blocked ? 0.0f : feq[q];
+            }
+            u[cell] = blocked ? 0.0f : inletVelocity;
+            v[cell] = 0.0f;
+        }
+        for (int k = 0; k < OUTLET_DIRECTIONS; k++) {
+            std::fill_n(&outletPopulations[0][k * N], N, feq[outletDirection[k]]);
+            std::fill_n(&outletPopulations[1][k * N], N, feq[outletDirection[k]]);
+        }
+        odd = false;
+    }
+
+    void update(float timestep) {
+        (void)timestep;
+        sf::Clock clock;
+
+        for (int step = 0; step < stepsPerUpdate; step++) {
+            bool storeMoments = step == stepsPerUpdate - 1;
+            JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+                for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                    if (odd) {
+                        oddRow(j, storeMoments);
+                    }
+                    else {
+                        evenRow(j, storeMoments);
+                    }
+                }
+            });
+            odd = !odd;
+        }
+
+        series[FluidSimulation::StepTime].add(clock.getElapsedTime().asSeconds());
+        for (int channel = 0; channel < FluidSimulation::ChannelCount; ++channel) {
+            stepTelemetry[channel] = series[channel].commit();
+        }
+    }
+
+    // The density view shows vorticity magnitude, since rho itself stays within a few
+    // percent of one. Velocities are scaled so the inlet speed reads as 10.
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        snapshot.fluidSize = N;
+        snapshot.density.assign(N * N, 0.0f);
+        snapshot.u.resize(N * N);
+        snapshot.v.resize(N * N);
+        snapshot.solid.resize(N * N);
+
+        float velocityScale = 10.0f / inletVelocity;
+        float vorticityScale = 0.05f * N / inletVelocity;
+        JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 0; i < N; i++) {
+                    int cell = i + j * N;
+                    snapshot.u[cell] = u[cell] * velocityScale;
+                    snapshot.v[cell] = v[cell] * velocityScale;
+                    snapshot.solid[cell] = isSolid(i, j) ? 1 : 0;
+                    if (i > 0 && i < N - 1 && j > 0 && j < N - 1) {
+                        float curl = 0.5f * (v[cell + 1] - v[cell - 1] - u[cell + N] + u[cell - N]);
+                        snapshot.density[cell] = std::abs(curl) * vorticityScale;
+                    }
+                }
+            }
+        });
+        snapshot.telemetry.assign(stepTelemetry, stepTelemetry + FluidSimulation::ChannelCount);
+    }
+
+    float getOmega() const {
+        return omega;
+    }
+
+private:
+    static const int Q = 9;
+    static const int ROW_GRAIN = 8;
+
+    // Rest, the four axis directions, then the diagonals; opposite[q] reverses c_q.
+    static constexpr int cx[Q] = { 0, 1, 0, -1, 0, 1, -1, -1, 1 };
+    static constexpr int cy[Q] = { 0, 0, 1, 0, -1, 1, 1, -1, -1 };
+    static constexpr int opposite[Q] = { 0, 3, 4, 1, 2, 7, 8, 5, 6 };
+    static constexpr float weight[Q] = { 4.0f / 9, 1.0f / 9, 1.0f / 9, 1.0f / 9, 1.0f / 9, 1.0f / 36, 1.0f / 36, 1.0f / 36, 1.0f / 36 };
+    // The directions that enter the outlet column from outside the grid.
+    static const int OUTLET_DIRECTIONS = 3;
+    static constexpr int outletDirection[OUTLET_DIRECTIONS] = { 3, 6, 7 };
+
+    int N;
+    int wordsPerRow;
+    std::vector<uint64_t> solidBits;
+    std::vector<float> populations; // Q planes of N * N
+    std::vector<float> u, v; // written on the last step of each update()
+    // Post-collision populations the outlet column sent toward the interior, by direction
+    // then row; a step writes the set for its parity and reads the other one.
+    std::vector<float> outletPopulations[2];
+    float omega = 1.0f;
+    bool odd = false;
+    TelemetrySeries series[FluidSimulation::ChannelCount];
+    TelemetrySample stepTelemetry[FluidSimulation::ChannelCount];
+
+    float* plane(int q) {
+        return &populations[static_cast<size_t>(q) * N * N];
+    }
+
+    bool isSolid(int i, int j) const {
+        return (solidBits[j * wordsPerRow + i / 64] >> (i % 64)) & 1;
+    }
+
+    // Outside the grid counts as solid, so the edges bounce back like obstacles.
+    bool blocked(int i, int j) const {
+        return i < 0 || i >= N || j < 0 || j >= N || isSolid(i, j);
+    }
+
+    // True if any of cells begin .. end - 1 in row j is solid.
+    bool anySolid(int begin, int end, int j) const {
+        const uint64_t* row = &solidBits[j * wordsPerRow];
+        for (int word = begin / 64; word <= (end - 1) / 64; word++) {
+            uint64_t bits = row[word];
+            if (word == begin / 64) {
+                bits &= ~uint64_t(0) << (begin % 64);
+            }
+            if (word == (end - 1) / 64 && end % 64 != 0) {
+                bits &= ~(~uint64_t(0) << (end % 64));
+            }
+            if (bits) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static void equilibrium(float rho, float ux, float uy, float* feq) {
+        float usq = 1.5f * (ux * ux + uy * uy);
+        for (int q = 0; q < Q; q++) {
+            float cu = 3.0f * (cx[q] * ux + cy[q] * uy);
+            feq[q] = weight[q] * rho * (((1.0f - usq) + cu) + 0.5f * (cu * cu));
+        }
+    }
+
+    // Regularized velocity inlet (Latt and Chopard): rho follows from the populations that
+    // did not come from outside the grid and the imposed velocity (inletVelocity, 0), the
+    // three that did take the non-equilibrium part of their opposites, as in Zou-He, and
+    // then every population is rebuilt from the equilibrium plus the stress that
+    // non-equilibrium part carries. Plain Zou-He does the same without the rebuild and
+    // blows up at the viscosities the scene runs at.
+    void inletCell(float* f) const {
+        float ux = inletVelocity;
+        float rho = (f[0] + f[2] + f[4] + 2.0f * (f[3] + f[6] + f[7])) / (1.0f - ux);
+        float feq[Q], neq[Q];
+        equilibrium(rho, ux, 0.0f, feq);
+        for (int q = 0; q < Q; q++) {
+            neq[q] = f[q] - feq[q];
+        }
+        neq[1] = neq[3];
+        neq[5] = neq[7];
+        neq[8] = neq[6];
+
+        float pxx = 0.0f, pyy = 0.0f, pxy = 0.0f;
+        for (int q = 0; q < Q; q++) {
+            pxx += cx[q] * cx[q] * neq[q];
+            pyy += cy[q] * cy[q] * neq[q];
+            pxy += cx[q] * cy[q] * neq[q];
+        }
+        for (int q = 0; q < Q; q++) {
+            float stress = (cx[q] * cx[q] - 1.0f / 3.0f) * pxx + (cy[q] * cy[q] - 1.0f / 3.0f) * pyy + 2.0f * cx[q] * cy[q] * pxy;
+            f[q] = feq[q] + 4.5f * weight[q] * stress;
+        }
+    }
+
+    // Zero gradient: a population arriving from outside the grid is the one the column
+    // before receives in the same direction, which an outlet cell sent last step. Beyond
+    // the top and bottom rows the wall's bounce-back stays.
+    void outletCell(int j, float* f) const {
+        const std::vector<float>& previous = outletPopulations[odd ? 0 : 1];
+        for (int k = 0; k < OUTLET_DIRECTIONS; k++) {
+            int q = outletDirection[k];
+            int sj = j - cy[q];
+            if (sj >= 0 && sj < N) {
+                f[q] = previous[k * N + sj];
+            }
+        }
+    }
+
+    // BGK on one cell, after the inlet and outlet columns fill in what came from outside
+    // the grid. The sums are grouped the way collide8 groups them.
+    void collide(int i, int j, float* f, float& ux, float& uy) {
+        if (i == 0) {
+            inletCell(f);
+        }
+        else if (i == N - 1) {
+            outletCell(j, f);
+        }
+        float rho = ((f[0] + f[1]) + (f[2] + f[3])) + ((f[4] + f[5]) + ((f[6] + f[7]) + f[8]));
+        float inverseRho = 1.0f / rho;
+        ux = ((f[1] - f[3]) + ((f[5] - f[6]) - (f[7] - f[8]))) * inverseRho;
+        uy = ((f[2] - f[4]) + ((f[5] + f[6]) - (f[7] + f[8]))) * inverseRho;
+        float feq[Q];
+        equilibrium(rho, ux, uy, feq);
+        for (int q = 0; q < Q; q++) {
+            f[q] += omega * (feq[q] - f[q]);
+        }
+        if (i == N - 1) {
+            std::vector<float>& current = outletPopulations[odd ? 1 : 0];
+            for (int k = 0; k < OUTLET_DIRECTIONS; k++) {
+                current[k * N + j] = f[outletDirection[k]];
+            }
+        }
+    }
+
+    void storeCell(int cell, float ux, float uy) {
+        u[cell] = ux;
+        v[cell] = uy;
+    }
+
+    void evenCell(int i, int j, bool storeMoments) {
+        if (isSolid(i, j)) {
+            return;
+        }
+        int cell = i + j * N;
+        float f[Q];
+        for (int q = 0; q < Q; q++) {
+            f[q] = plane(q)[cell];
+        }
+        float ux, uy;
+        collide(i, j, f, ux, uy);
+        for (int q = 0; q < Q; q++) {
+            plane(opposite[q])[cell] = f[q];
+        }
+        if (storeMoments) {
+            storeCell(cell, ux, uy);
+        }
+    }
+
+    // A population arriving from a solid is the one this cell sent the other way last
+    // step, which the even step left in this cell's slot q; one leaving toward a solid is
+    // stored where the next even step reads the reversed direction.
+    void oddCell(int i, int j, bool storeMoments) {
+        if (isSolid(i, j)) {
+            return;
+        }
+        int cell = i + j * N;
+        float f[Q];
+        for (int q = 0; q < Q; q++) {
+            int si = i - cx[q];
+            int sj = j - cy[q];
+            f[q] = blocked(si, sj) ? plane(q)[cell] : plane(opposite[q])[si + sj * N];
+        }
+        float ux, uy;
+        collide(i, j, f, ux, uy);
+        for (int q = 0; q < Q; q++) {
+            int ti = i + cx[q];
+            int tj = j + cy[q];
+            if (blocked(ti, tj)) {
+                plane(opposite[q])[cell] = f[q];
+            }
+            else {
+                plane(q)[ti + tj * N] = f[q];
+            }
+        }
+        if (storeMoments) {
+            storeCell(cell, ux, uy);
+        }
+    }
+
+    void evenRow(int j, bool storeMoments) {
+        int i = 0;
+#ifdef LBM_AVX2
+        if (j > 0 && j < N - 1) {
+            evenCell(0, j, storeMoments);
+            i = 1;
+            for (; i + 8 <= N - 1; i += 8) {
+                if (anySolid(i, i + 8, j)) {
+                    for (int k = i; k < i + 8; k++) {
+                        evenCell(k, j, storeMoments);
+                    }
+                    continue;
+                }
+                int cell = i + j * N;
+                __m256 f[Q];
+                for (int q = 0; q < Q; q++) {
+                    f[q] = _mm256_loadu_ps(&plane(q)[cell]);
+                }
+                collide8(f, cell, storeMoments);
+                for (int q = 0; q < Q; q++) {
+                    _mm256_storeu_ps(&plane(opposite[q])[cell], f[q]);
+                }
+            }
+        }
+#endif
+        for (; i < N; i++) {
+            evenCell(i, j, storeMoments);
+        }
+    }
+
+    void oddRow(int j, bool storeMoments) {
+        int i = 0;
+#ifdef LBM_AVX2
+        if (j > 0 && j < N - 1) {
+            oddCell(0, j, storeMoments);
+            i = 1;
+            for (; i + 8 <= N - 1; i += 8) {
+                if (anySolid(i - 1, i + 9, j - 1) || anySolid(i - 1, i + 9, j) || anySolid(i - 1, i + 9, j + 1)) {
+                    for (int k = i; k < i + 8; k++) {
+                        oddCell(k, j, storeMoments);
+                    }
+                    continue;
+                }
+                int cell = i + j * N;
+                __m256 f[Q];
+                for (int q = 0; q < Q; q++) {
+                    f[q] = _mm256_loadu_ps(&plane(opposite[q])[cell - cx[q] - cy[q] * N]);
+                }
+                collide8(f, cell, storeMoments);
+                for (int q = 0; q < Q; q++) {
+                    _mm256_storeu_ps(&plane(q)[cell + cx[q] + cy[q] * N], f[q]);
+                }
+            }
+        }
+#endif
+        for (; i < N; i++) {
+            oddCell(i, j, storeMoments);
+        }
+    }
+
+#ifdef LBM_AVX2
+    // BGK on eight interior cells starting at cell.
+    void collide8(__m256* f, int cell, bool storeMoments) {
+        __m256 rho = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(f[0], f[1]), _mm256_add_ps(f[2], f[3])),
+            _mm256_add_ps(_mm256_add_ps(f[4], f[5]), _mm256_add_ps(_mm256_add_ps(f[6], f[7]), f[8])));
+        __m256 inverseRho = _mm256_div_ps(_mm256_set1_ps(1.0f), rho);
+        __m256 diagonalX = _mm256_sub_ps(_mm256_sub_ps(f[5], f[6]), _mm256_sub_ps(f[7], f[8]));
+        __m256 diagonalY = _mm256_sub_ps(_mm256_add_ps(f[5], f[6]), _mm256_add_ps(f[7], f[8]));
+        __m256 ux = _mm256_mul_ps(_mm256_add_ps(_mm256_sub_ps(f[1], f[3]), diagonalX), inverseRho);
+        __m256 uy = _mm256_mul_ps(_mm256_add_ps(_mm256_sub_ps(f[2], f[4]), diagonalY), inverseRho);
+        if (storeMoments) {
+            _mm256_storeu_ps(&u[cell], ux);
+            _mm256_storeu_ps(&v[cell], uy);
+        }
+
+        __m256 vomega = _mm256_set1_ps(omega);
+        __m256 one = _mm256_set1_ps(1.0f);
+        __m256 half = _mm256_set1_ps(0.5f);
+        __m256 three = _mm256_set1_ps(3.0f);
+        __m256 usq = _mm256_mul_ps(_mm256_set1_ps(1.5f), _mm256_add_ps(_mm256_mul_ps(ux, ux), _mm256_mul_ps(uy, uy)));
+        __m256 base = _mm256_sub_ps(one, usq);
+        for (int q = 0; q < Q; q++) {
+            __m256 cu = _mm256_mul_ps(three, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(float(cx[q])), ux), _mm256_mul_ps(_mm256_set1_ps(float(cy[q])), uy)));
+            __m256 polynomial = _mm256_add_ps(_mm256_add_ps(base, cu), _mm256_mul_ps(half, _mm256_mul_ps(cu, cu)));
+            __m256 feq = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(weight[q]), rho), polynomial);
+            f[q] = _mm256_add_ps(f[q], _mm256_mul_ps(vomega, _mm256_sub_ps(feq, f[q])));
+        }
+    }
+#endif
+};
+
+#endif
@@ -0,0 +1,240 @@
+#ifndef MULTIGRID_SOLVER_H
+#define MULTIGRID_SOLVER_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "JobSystem.h"
+
+// Geometric multigrid for the pressure Poisson equation on an N x N grid laid out like
+// FluidSimulation (index i + j * N, one boundary cell on each side). Solves
+// 4p - (neighbors) = rhs on the interior with the same zero-gradient walls that
+// setBoundary(0, p) produces: a wall neighbor simply drops out of the stencil.
+// Cell-centered levels halve the interior each time; restriction averages the 2x2
+// children, prolongation is bilinear and smoothing is red-black Gauss-Seidel.
+class MultigridSolver {
+public:
+    enum class Cycle { V, W };
+
+    Cycle cycle = Cycle::V;
+    int preSmooth = 2;
+    int postSmooth = 2;
+    int coarseSmooth = 40;
+    int maxCycles = 30;
+    float tolerance = 1e-4f; // relative to the norm of rhs
+
+    // Returns the number of cycles used; p is used as the initial guess.
+    int solve(std::vector<float>& p, const std::vector<float>& rhs, int N) {
+        buildLevels(N - 2);
+        Level& fine = levels[0];
+
+        for (int j = 1; j <= fine.n; j++) {
+            for (int i = 1; i <= fine.n; i++) {
+                fine.x[fine.index(i, j)] = p[i + j * N];
+                fine.b[fine.index(i, j)] = rhs[i + j * N];
+            }
+        }
+        removeMean(fine, fine.b);
+
+        float rhsNorm = norm(fine, fine.b);
+        cycles = 0;
+        residual = 0.0f;
+        if (rhsNorm > 0.0f) {
+            while (cycles < maxCycles) {
+                runCycle(0);
+                cycles++;
+                computeResidual(fine);
+                residual = norm(fine, fine.r) / rhsNorm;
+                if (residual < tolerance) {
+                    break;
+                }
+            }
+        }
+
+        for (int j = 1; j <= fine.n; j++) {
+            for (int i = 1; i <= fine.n; i++) {
+                p[i + j * N] = fine.x[fine.index(i, j)];
+            }
+        }
+        return cycles;
+    }
+
+    int getCycles() const {
+        return cycles;
+    }
+
+    float getResidual() const {
+        return residual;
+    }
+
+private:
+    struct Level {
+        int n = 0;     // interior cells per side
+        float h2 = 1;  // squared spacing relative to the finest level
+        std::vector<float> x, b, r;
+
+        int index(int i, int j) const {
+            return i + j * (n + 2);
+        }
+    };
+
+    std::vector<Level> levels;
+    int cycles = 0;
+    float residual = 0.0f;
+
+    void buildLevels(int n) {
+        if (!levels.empty() && levels[0].n == n) {
+            return;
+        }
+
+        levels.clear();
+        float h2 = 1.0f;
+        while (true) {
+            Level level;
+            level.n = n;
+            level.h2 = h2;
+            size_t cells = static_cast<size_t>(n + 2) * (n + 2);
+            level.x.assign(cells, 0.0f);
+            level.b.assign(cells, 0.0f);
+            level.r.assign(cells, 0.0f);
+            levels.push_back(std::move(level));
+            if (n <= 4) {
+                break;
+            }
+            n = (n + 1) / 2;
+            h2 *= 4.0f;
+        }
+    }
+
+    void runCycle(size_t l) {
+        Level& level = levels[l];
+        if (l + 1 == levels.size()) {
+            smooth(level, coarseSmooth);
+            return;
+        }
+
+        smooth(level, preSmooth);
+        computeResidual(level);
+
+        Level& coarse = levels[l + 1];
+        restrictResidual(level, coarse);
+        std::fill(coarse.x.begin(), coarse.x.end(), 0.0f);
+
+        int visits = cycle == Cycle::W && l + 2 < levels.size() ? 2 : 1;
+        for (int k = 0; k < visits; k++) {
+            runCycle(l + 1);
+        }
+
+        prolongAndCorrect(coarse, level);
+        smooth(level, postSmooth);
+    }
+
+    // Sum of interior neighbors and how many there are; walls drop out (Neumann).
+    static float neighborSum(const Level& level, const std::vector<float>& x, int i, int j, float& count) {
+        int n = level.n;
+        int c = level.index(i, j);
+        int stride = n + 2;
+        float sum = 0.0f;
+        count = 0.0f;
+        if (i > 1) { sum += x[c - 1]; count += 1.0f; }
+        if (i < n) { sum += x[c + 1]; count += 1.0f; }
+        if (j > 1) { sum += x[c - stride]; count += 1.0f; }
+        if (j < n) { sum += x[c + stride]; count += 1.0f; }
+        return sum;
+    }
+
+    void smooth(Level& level, int iterations) {
+        for (int k = 0; k < iterations; k++) {
+            for (int color = 0; color < 2; color++) {
+                JobSystem::instance().parallelFor(1, level.n + 1, 16, [&](size_t rowBegin, size_t rowEnd) {
+                    for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                        for (int i = 1 + ((j + 1 + color) & 1); i <= level.n; i += 2) {
+                            float count;
+                            float sum = neighborSum(level, level.x, i, j, count);
+                            if (count > 0.0f) {
+                                level.x[level.index(i, j)] = (level.h2 * level.b[level.index(i, j)] + sum) / count;
+                            }
+                        }
+                    }
+                });
+            }
+        }
+    }
+
+    void computeResidual(Level& level) {
+        float invH2 = 1.0f / level.h2;
+        JobSystem::instance().parallelFor(1, level.n + 1, 16, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 1; i <= level.n; i++) {
+                    float count;
+                    float sum = neighborSum(level, level.x, i, j, count);
+                    int c = level.index(i, j);
+                    level.r[c] = level.b[c] - (count * level.x[c] - sum) * invH2;
+                }
+            }
+        });
+    }
+
+    void restrictResidual(const Level& fine, Level& coarse) {
+        for (int J = 1; J <= coarse.n; J++) {
+            for (int I = 1; I <= coarse.n; I++) {
+                float sum = 0.0f;
+                float count = 0.0f;
+                for (int j = 2 * J - 1; j <= std::min(2 * J, fine.n); j++) {
+                    for (int i = 2 * I - 1; i <= std::min(2 * I, fine.n); i++) {
+                        sum += fine.r[fine.index(i, j)];
+                        count += 1.0f;
+                    }
+                }
+                coarse.b[coarse.index(I, J)] = sum / count;
+            }
+        }
+        removeMean(coarse, coarse.b);
+    }
+
+    void prolongAndCorrect(const Level& coarse, Level& fine) {
+        JobSystem::instance().parallelFor(1, fine.n + 1, 16, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                int J = (j + 1) / 2;
+                int J2 = std::min(std::max((j & 1) ? J - 1 : J + 1, 1), coarse.n);
+                for (int i = 1; i <= fine.n; i++) {
+                    int I = (i + 1) / 2;
+                    int I2 = std::min(std::max((i & 1) ? I - 1 : I + 1, 1), coarse.n);
+                    float value = 0.5625f * coarse.x[coarse.index(I, J)] +
+                        0.1875f * (coarse.x[coarse.index(I2, J)] + coarse.x[coarse.index(I, J2)]) +
+                        0.0625f * coarse.x[coarse.index(I2, J2)];
+                    fine.x[fine.index(i, j)] += value;
+                }
+            }
+        });
+    }
+
+    // The all-Neumann problem only has a solution for zero-mean right-hand sides.
+    static void removeMean(const Level& level, std::vector<float>& values) {
+        double sum = 0.0;
+        for (int j = 1; j <= level.n; j++) {
+            for (int i = 1; i <= level.n; i++) {
+                sum += values[level.index(i, j)];
+            }
+        }
+        float mean = static_cast<float>(sum / (double(level.n) * level.n));
+        for (int j = 1; j <= level.n; j++) {
+            for (int i = 1; i <= level.n; i++) {
+                values[level.index(i, j)] -= mean;
+            }
+        }
+    }
+
+    static float norm(const Level& level, const std::vector<float>& values) {
+        double sum = 0.0;
+        for (int j = 1; j <= level.n; j++) {
+            for (int i = 1; i <= level.n; i++) {
+                double value = values[level.index(i, j)];
+                sum += value * value;
+            }
+        }
+        return static_cast<float>(std::sqrt(sum));
+    }
+};
+
+#endif
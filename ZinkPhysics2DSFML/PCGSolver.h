@@ -0,0 +1,278 @@
+#ifndef PCG_SOLVER_H
+#define PCG_SOLVER_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "JobSystem.h"
+
+// Matrix-free preconditioned conjugate gradient for the pressure Poisson equation
+// restricted to fluid cells. Walls and solid cells are zero-gradient: a neighbor that
+// is not fluid drops out of the stencil, exactly as in MultigridSolver. The caller's p
+// is the initial guess, so passing last step's pressure warm starts the solve.
+class PCGSolver {
+public:
+    enum class Preconditioner {
+        MIC0,  // modified incomplete Cholesky, serial triangular solves
+        Jacobi // diagonal, every step is a parallel sweep
+    };
+
+    Preconditioner preconditioner = Preconditioner::MIC0;
+    int maxIterations = 200;
+    float tolerance = 1e-4f; // relative to the norm of rhs
+    float micTuning = 0.97f;
+    float micSafety = 0.25f;
+
+    // solid may be empty; otherwise nonzero marks a cell the fluid cannot enter.
+    int solve(std::vector<float>& p, const std::vector<float>& rhs, const std::vector<uint8_t>& solid, int N) {
+        setup(solid, N);
+
+        size_t cells = static_cast<size_t>(N) * N;
+        r.assign(cells, 0.0f);
+        z.assign(cells, 0.0f);
+        s.assign(cells, 0.0f);
+        q.assign(cells, 0.0f);
+
+        // The all-Neumann system is singular; only the zero-mean part of rhs is solvable.
+        double sum = 0.0;
+        for (size_t c = 0; c < cells; c++) {
+            if (fluid[c]) sum += rhs[c];
+        }
+        float mean = fluidCount > 0 ? static_cast<float>(sum / fluidCount) : 0.0f;
+
+        forRows([&](int c) {
+            if (!fluid[c]) {
+                p[c] = 0.0f;
+            }
+        });
+        multiply(p, q);
+        forRows([&](int c) {
+            r[c] = fluid[c] ? rhs[c] - mean - q[c] : 0.0f;
+        });
+
+        float rhsNorm = 0.0f;
+        {
+            double total = 0.0;
+            for (size_t c = 0; c < cells; c++) {
+                if (fluid[c]) {
+                    double value = rhs[c] - mean;
+                    total += value * value;
+                }
+            }
+            rhsNorm = static_cast<float>(std::sqrt(total));
+        }
+
+        iterations = 0;
+        residual = 0.0f;
+        if (rhsNorm == 0.0f) {
+            return 0;
+        }
+
+        residual = std::sqrt(dot(r, r)) / rhsNorm;
+        if (residual < tolerance) {
+            return 0;
+        }
+
+        applyPreconditioner(r, z);
+        s = z;
+        double sigma = dot(z, r);
+
+        while (iterations < maxIterations) {
+            iterations++;
+            multiply(s, z);
+            double denominator = dot(z, s);
+            if (denominator == 0.0) {
+                break;
+            }
+            float alpha = static_cast<float>(sigma / denominator);
+
+            forRows([&](int c) {
+                p[c] += alpha * s[c];
+                r[c] -= alpha * z[c];
+            });
+
+            residual = std::sqrt(dot(r, r)) / rhsNorm;
+            if (residual < tolerance) {
+                break;
+            }
+
+            applyPreconditioner(r, z);
+            double sigmaNew = dot(z, r);
+            float beta = static_cast<float>(sigmaNew / sigma);
+            forRows([&](int c) {
+                s[c] = z[c] + beta * s[c];
+            });
+            sigma = sigmaNew;
+        }
+        return iterations;
+    }
+
+    int getIterations() const {
+        return iterations;
+    }
+
+    float getResidual() const {
+        return residual;
+    }
+
+private:
+    int N = 0;
+    size_t fluidCount = 0;
+    std::vector<uint8_t> fluid, solidCache;
+    std::vector<float> diagonal, precon;
+    std::vector<float> r, z, s, q;
+    std::vector<double> rowSums;
+    int iterations = 0;
+    float residual = 0.0f;
+    bool preconDirty = true;
+
+    // Rebuilds the fluid mask and MIC(0) factors only when the obstacles changed.
+    void setup(const std::vector<uint8_t>& solid, int size) {
+        if (size == N && solid == solidCache && !fluid.empty()) {
+            return;
+        }
+
+        N = size;
+        solidCache = solid;
+        size_t cells = static_cast<size_t>(N) * N;
+        fluid.assign(cells, 0);
+        diagonal.assign(cells, 0.0f);
+        fluidCount = 0;
+
+        for (int j = 1; j < N - 1; j++) {
+            for (int i = 1; i < N - 1; i++) {
+                int c = i + j * N;
+                fluid[c] = solid.empty() || !solid[c];
+                fluidCount += fluid[c];
+            }
+        }
+        for (int j = 1; j < N - 1; j++) {
+            for (int i = 1; i < N - 1; i++) {
+                int c = i + j * N;
+                if (fluid[c]) {
+                    diagonal[c] = float(fluid[c - 1] + fluid[c + 1] + fluid[c - N] + fluid[c + N]);
+                }
+            }
+        }
+        preconDirty = true;
+    }
+
+    template <typename Body>
+    void forRows(Body&& body) {
+        JobSystem::instance().parallelFor(1, N - 1, 16, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 1; i < N - 1; i++) {
+                    body(i + j * N);
+                }
+            }
+        });
+    }
+
+    double dot(const std::vector<float>& a, const std::vector<float>& b) {
+        rowSums.assign(N, 0.0);
+        JobSystem::instance().parallelFor(1, N - 1, 16, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                double sum = 0.0;
+                for (int i = 1; i < N - 1; i++) {
+                    int c = i + j * N;
+                    sum += double(a[c]) * b[c];
+                }
+                rowSums[j] = sum;
+            }
+        });
+        double total = 0.0;
+        for (double value : rowSums) {
+            total += value;
+        }
+        return total;
+    }
+
+    void multiply(const std::vector<float>& x, std::vector<float>& result) {
+        forRows([&](int c) {
+            if (!fluid[c]) {
+                result[c] = 0.0f;
+                return;
+            }
+            float sum = 0.0f;
+            if (fluid[c - 1]) sum += x[c - 1];
+            if (fluid[c + 1]) sum += x[c + 1];
+            if (fluid[c - N]) sum += x[c - N];
+            if (fluid[c + N]) sum += x[c + N];
+            result[c] = diagonal[c] * x[c] - sum;
+        });
+    }
+
+    void buildMIC() {
+        precon.assign(fluid.size(), 0.0f);
+        for (int j = 1; j < N - 1; j++) {
+            for (int i = 1; i < N - 1; i++) {
+                int c = i + j * N;
+                if (!fluid[c] || diagonal[c] == 0.0f) {
+                    continue;
+                }
+
+                // Off-diagonal entries are -1 between fluid neighbors.
+                float left = fluid[c - 1] ? -1.0f : 0.0f;
+                float down = fluid[c - N] ? -1.0f : 0.0f;
+                float pl = precon[c - 1];
+                float pd = precon[c - N];
+                float leftUp = fluid[c - 1] && fluid[c - 1 + N] ? -1.0f : 0.0f;
+                float downRight = fluid[c - N] && fluid[c - N + 1] ? -1.0f : 0.0f;
+
+                float e = diagonal[c]
+                    - (left * pl) * (left * pl)
+                    - (down * pd) * (down * pd)
+                    - micTuning * (left * leftUp * pl * pl + down * downRight * pd * pd);
+                if (e < micSafety * diagonal[c]) {
+                    e = diagonal[c];
+                }
+                precon[c] = 1.0f / std::sqrt(e);
+            }
+        }
+        preconDirty = false;
+    }
+
+    void applyPreconditioner(const std::vector<float>& input, std::vector<float>& output) {
+        if (preconditioner == Preconditioner::Jacobi) {
+            forRows([&](int c) {
+                output[c] = fluid[c] && diagonal[c] > 0.0f ? input[c] / diagonal[c] : 0.0f;
+            });
+            return;
+        }
+
+        if (preconDirty) {
+            buildMIC();
+        }
+
+        // Solve L q = input, then L^T output = q, with L built from precon.
+        for (int j = 1; j < N - 1; j++) {
+            for (int i = 1; i < N - 1; i++) {
+                int c = i + j * N;
+                if (!fluid[c]) {
+                    q[c] = 0.0f;
+                    continue;
+                }
+                float t = input[c];
+                if (fluid[c - 1]) t += precon[c - 1] * q[c - 1];
+                if (fluid[c - N]) t += precon[c - N] * q[c - N];
+                q[c] = t * precon[c];
+            }
+        }
+        for (int j = N - 2; j >= 1; j--) {
+            for (int i = N - 2; i >= 1; i--) {
+                int c = i + j * N;
+                if (!fluid[c]) {
+                    output[c] = 0.0f;
+                    continue;
+                }
+                float t = q[c];
+                if (fluid[c + 1]) t += precon[c] * output[c + 1];
+                if (fluid[c + N]) t += precon[c] * output[c + N];
+                output[c] = t * precon[c];
+            }
+        }
+    }
+};
+
+#endif
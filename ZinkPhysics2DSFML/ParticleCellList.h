@@ -0,0 +1,141 @@
+#ifndef PARTICLE_CELL_LIST_H
+#define PARTICLE_CELL_LIST_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include "JobSystem.h"
+
+// Uniform-grid neighbor search for particle solvers. build() counting-sorts particle
+// indices by cell (row-major, cells of cellSize); reorder() then permutes the caller's
+// particle arrays into that order, so afterwards the particles of cell c are exactly
+// cellBegin(c) .. cellEnd(c) and a row of three neighboring cells is one contiguous
+// range of memory.
+//
+// The sort runs in parallel without atomics: every thread counts a fixed range of
+// particles into its own histogram, one exclusive scan turns the histograms into write
+// offsets, and each range scatters its indices in order. The result is a stable sort,
+// independent of scheduling.
+class ParticleCellList {
+public:
+    void build(const float* x, const float* y, size_t count, float cellSize, float width, float height) {
+        size = cellSize;
+        inverseSize = 1.0f / cellSize;
+        cellsX = std::max(1, int(width * inverseSize) + 1);
+        cellsY = std::max(1, int(height * inverseSize) + 1);
+        int cells = cellsX * cellsY;
+
+        cellOf.resize(count);
+        order.resize(count);
+        int ranges = int(JobSystem::instance().getConcurrency());
+        size_t perRange = (count + ranges - 1) / std::max(ranges, 1);
+        histograms.assign(static_cast<size_t>(ranges) * cells, 0);
+
+        JobSystem::instance().parallelFor(0, ranges, 1, [&](size_t rangeBegin, size_t rangeEnd) {
+            for (size_t range = rangeBegin; range < rangeEnd; range++) {
+                uint32_t* histogram = &histograms[range * cells];
+                size_t end = std::min(count, (range + 1) * perRange);
+                for (size_t k = range * perRange; k < end; k++) {
+                    int cell = cellAt(x[k], y[k]);
+                    cellOf[k] = cell;
+                    histogram[cell]++;
+                }
+            }
+        });
+
+        // Cell-major, then range-major: cell c's particles from range 0 come first.
+        start.resize(cells + 1);
+        uint32_t offset = 0;
+        for (int cell = 0; cell < cells; cell++) {
+            start[cell] = offset;
+            for (int range = 0; range < ranges; range++) {
+                uint32_t& slot = histograms[static_cast<size_t>(range) * cells + cell];
+                uint32_t n = slot;
+                slot = offset;
+                offset += n;
+            }
+        }
+        start[cells] = offset;
+
+        JobSystem::instance().parallelFor(0, ranges, 1, [&](size_t rangeBegin, size_t rangeEnd) {
+            for (size_t range = rangeBegin; range < rangeEnd; range++) {
+                uint32_t* next = &histograms[range * cells];
+                size_t end = std::min(count, (range + 1) * perRange);
+                for (size_t k = range * perRange; k < end; k++) {
+                    order[next[cellOf[k]]++] = uint32_t(k);
+                }
+            }
+        });
+    }
+
+    // Permutes one particle array into cell order; call for every array after build().
+    void reorder(std::vector<float>& values) {
+        scratch.resize(values.size());
+        JobSystem::instance().parallelFor(0, order.size(), 4096, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                scratch[k] = values[order[k]];
+            }
+        });
+        values.swap(scratch);
+    }
+
+    int cellAt(float x, float y) const {
+        int cx = std::min(std::max(int(x * inverseSize), 0), cellsX - 1);
+        int cy = std::min(std::max(int(y * inverseSize), 0), cellsY - 1);
+        return cx + cy * cellsX;
+    }
+
+    // Calls body(begin, end) once per row of the 3x3 block around (x, y): each row's
+    // three cells are adjacent in the sorted order, so they form a single range.
+    template <typename Body>
+    void forNeighborRanges(float x, float y, Body&& body) const {
+        int cx = std::min(std::max(int(x * inverseSize), 0), cellsX - 1);
+        int cy = std::min(std::max(int(y * inverseSize), 0), cellsY - 1);
+        int left = std::max(cx - 1, 0);
+        int right = std::min(cx + 1, cellsX - 1);
+        for (int row = std::max(cy - 1, 0); row <= std::min(cy + 1, cellsY - 1); row++) {
+            uint32_t begin = start[left + row * cellsX];
+            uint32_t end = start[right + row * cellsX + 1];
+            if (begin < end) {
+                body(begin, end);
+            }
+        }
+    }
+
+    uint32_t cellBegin(int cell) const {
+        return start[cell];
+    }
+
+    uint32_t cellEnd(int cell) const {
+        return start[cell + 1];
+    }
+
+    int getCellsX() const {
+        return cellsX;
+    }
+
+    int getCellsY() const {
+        return cellsY;
+    }
+
+    float getCellSize() const {
+        return size;
+    }
+
+    // order[k] is the pre-sort index of the particle now at k.
+    const std::vector<uint32_t>& getOrder() const {
+        return order;
+    }
+
+private:
+    float size = 1.0f;
+    float inverseSize = 1.0f;
+    int cellsX = 0, cellsY = 0;
+    std::vector<uint32_t> start;
+    std::vector<uint32_t> order;
+    std::vector<int> cellOf;
+    std::vector<uint32_t> histograms;
+    std::vector<float> scratch;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#ifndef PARTICLE_FLUID_H
+#define PARTICLE_FLUID_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define PARTICLE_FLUID_AVX2 1
+#endif
+
+// Pieces shared by the particle fluids (SphFluidSimulation, PbfFluidSimulation):
+// the 2D smoothing kernels, the container and obstacle collision, and the AVX2 helpers
+// for streaming over ParticleCellList ranges.
+
+// 2D kernel constants for support radius h. poly6 is (h^2 - r^2)^3 times poly6, the
+// spiky gradient is spiky * (h - r)^2 along the unit offset, the viscosity Laplacian
+// is laplacian * (h - r).
+struct ParticleKernels {
+    float h, h2;
+    float poly6, spiky, laplacian;
+
+    explicit ParticleKernels(float radius) : h(radius), h2(radius * radius) {
+        const float pi = 3.14159265f;
+        poly6 = 4.0f / (pi * std::pow(h, 8.0f));
+        spiky = 30.0f / (pi * std::pow(h, 5.0f));
+        laplacian = 40.0f / (pi * std::pow(h, 5.0f));
+    }
+
+    // Particle mass that puts a particle inside a square lattice of the given spacing
+    // exactly at restDensity.
+    float latticeMass(float spacing, float restDensity) const {
+        float sum = 0.0f;
+        int reach = int(std::ceil(h / spacing));
+        for (int b = -reach; b <= reach; b++) {
+            for (int a = -reach; a <= reach; a++) {
+                float r2 = (a * a + b * b) * spacing * spacing;
+                if (r2 < h2) {
+                    sum += (h2 - r2) * (h2 - r2) * (h2 - r2);
+                }
+            }
+        }
+        return restDensity / (poly6 * sum);
+    }
+};
+
+// The window-sized box and circular obstacles the particles live in. Particles keep
+// margin away from every wall.
+struct ParticleBounds {
+    struct Obstacle {
+        float x, y, radius;
+    };
+
+    float width = 0.0f, height = 0.0f, margin = 0.0f;
+    std::vector<Obstacle> obstacles;
+
+    bool insideObstacle(float x, float y) const {
+        for (const Obstacle& obstacle : obstacles) {
+            float dx = x - obstacle.x;
+            float dy = y - obstacle.y;
+            if (dx * dx + dy * dy < obstacle.radius * obstacle.radius) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Moves (x, y) back inside and reflects the velocity's inward part, scaled by
+    // restitution. Pass restitution 0 to only remove it, as clamp() does.
+    void collide(float& x, float& y, float& vx, float& vy, float restitution) const {
+        if (x < margin) {
+            x = margin;
+            vx = -restitution * vx;
+        }
+        if (x > width - margin) {
+            x = width - margin;
+            vx = -restitution * vx;
+        }
+        if (y < margin) {
+            y = margin;
+            vy = -restitution * vy;
+        }
+        if (y > height - margin) {
+            y = height - margin;
+            vy = -restitution * vy;
+        }
+        for (const Obstacle& obstacle : obstacles) {
+            float dx = x - obstacle.x;
+            float dy = y - obstacle.y;
+            float d2 = dx * dx + dy * dy;
+            float reach = obstacle.radius + margin;
+            if (d2 < reach * reach && d2 > 0.0f) {
+                float d = std::sqrt(d2);
+                float nx = dx / d;
+                float ny = dy / d;
+                x = obstacle.x + nx * reach;
+                y = obstacle.y + ny * reach;
+                float inward = vx * nx + vy * ny;
+                if (inward < 0.0f) {
+                    vx -= (1.0f + restitution) * inward * nx;
+                    vy -= (1.0f + restitution) * inward * ny;
+                }
+            }
+        }
+    }
+
+    // Position-only version for solvers that derive velocity from the positions.
+    void clamp(float& x, float& y) const {
+        float vx = 0.0f;
+        float vy = 0.0f;
+        collide(x, y, vx, vy, 0.0f);
+    }
+};
+
+#ifdef PARTICLE_FLUID_AVX2
+// All lanes below remaining; a short range needs no scalar tail.
+inline __m256i particleTailMask(uint32_t remaining) {
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    return _mm256_cmpgt_epi32(_mm256_set1_epi32(int(std::min(remaining, 8u))), lane);
+}
+
+inline float particleHorizontalSum(__m256 v) {
+    __m128 low = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    low = _mm_add_ps(low, _mm_movehl_ps(low, low));
+    low = _mm_add_ss(low, _mm_shuffle_ps(low, low, 1));
+    return _mm_cvtss_f32(low);
+}
+#endif
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef PARTICLE_RENDERER_H
+#define PARTICLE_RENDERER_H
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <algorithm>
+#include "RenderSnapshot.h"
+#include "JobSystem.h"
+
+// Draws the snapshot's particles as one point per particle out of a single vertex
+// buffer, colored by particleValue through a lookup table.
+class ParticleRenderer {
+public:
+    float valueScale = 1.0f / 400.0f; // reciprocal of the particleValue at the top of the table
+
+    ParticleRenderer() {
+        for (int k = 0; k < 256; k++) {
+            float t = k / 255.0f;
+            colors[k] = sf::Color(static_cast<sf::Uint8>(20 + 60 * t), static_cast<sf::Uint8>(60 + 150 * t), static_cast<sf::Uint8>(160 + 95 * t));
+        }
+        useVertexBuffer = sf::VertexBuffer::isAvailable();
+        vertexBuffer.setPrimitiveType(sf::Points);
+        vertexBuffer.setUsage(sf::VertexBuffer::Stream);
+    }
+
+    void update(const RenderSnapshot& snapshot) {
+        size_t count = snapshot.particleX.size();
+        if (vertices.size() != count) {
+            vertices.resize(count);
+            if (useVertexBuffer) {
+                vertexBuffer.create(count);
+            }
+        }
+
+        bool colored = snapshot.particleValue.size() == count;
+        JobSystem::instance().parallelFor(0, count, 4096, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                int index = colored ? static_cast<int>(std::min(std::max(snapshot.particleValue[k] * valueScale, 0.0f), 1.0f) * 255.0f) : 0;
+                vertices[k] = sf::Vertex(sf::Vector2f(snapshot.particleX[k], snapshot.particleY[k]), colors[index]);
+            }
+        });
+
+        if (useVertexBuffer && !vertices.empty()) {
+            vertexBuffer.update(vertices.data());
+        }
+    }
+
+    void render(sf::RenderWindow& window, const RenderSnapshot& snapshot, bool fresh) {
+        if (fresh) {
+            update(snapshot);
+        }
+        if (vertices.empty()) {
+            return;
+        }
+        if (useVertexBuffer) {
+            window.draw(vertexBuffer);
+        }
+        else {
+            window.draw(vertices.data(), vertices.size(), sf::Points);
+        }
+    }
+
+private:
+    sf::Color colors[256];
+    sf::VertexBuffer vertexBuffer;
+    std::vector<sf::Vertex> vertices;
+    bool useVertexBuffer = false;
+};
+
+#endif
@@ -0,0 +1,361 @@
+#ifndef PBF_FLUID_SIMULATION_H
+#define PBF_FLUID_SIMULATION_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "JobSystem.h"
+#include "ParticleCellList.h"
+#include "ParticleFluid.h"
+#include "RenderSnapshot.h"
+
+// Position Based Fluids (Macklin and Mueller 2013) on the same particle layout, kernels
+// and cell list as SphFluidSimulation. Instead of integrating stiff pressure forces, each
+// substep predicts positions under gravity and then projects them onto the density
+// constraints rho_i / rho0 - 1 = 0 with a few Jacobi iterations, which stays stable at
+// timesteps many times the SPH acoustic limit; the substep count only has to keep the
+// fastest particle within about one smoothing radius per substep.
+//
+// Every iteration is two parallel passes over the cell-sorted particles: the constraint
+// multipliers lambda, then the position corrections, which only read lambda and the
+// positions of the previous iteration. The artificial pressure term s_corr keeps the
+// free surface from clumping; C is clamped at zero as in the SPH pressure, so the
+// constraints only push. Velocities come from the position change, smoothed by XSPH.
+class PbfFluidSimulation {
+public:
+    float restDensity = 1.0f;
+    float gravity = 980.0f;       // pixels per second^2
+    float courant = 1.0f;         // largest step, in smoothing radii, a particle may take per substep
+    int minSubsteps = 2;
+    int maxSubsteps = 4;
+    int iterations = 6;
+    float relaxation = 0.05f;     // constraint softening, relative to the rest-state gradient norm
+    float correctionScale = 0.1f; // s_corr = -k (W(r) / W(0.2 h))^4
+    float xsph = 0.05f;
+    float maxSpeed = 2000.0f;
+
+    // spacing is the initial particle distance; the smoothing radius is twice that.
+    PbfFluidSimulation(float width, float height, float spacing)
+        : spacing(spacing), kernels(2.0f * spacing) {
+        mass = kernels.latticeMass(spacing, restDensity);
+        bounds.width = width;
+        bounds.height = height;
+        bounds.margin = 0.5f * spacing;
+
+        // sum |grad C|^2 for a particle inside the rest lattice, the scale for epsilon.
+        float gradX = 0.0f;
+        float squares = 0.0f;
+        int reach = int(std::ceil(kernels.h / spacing));
+        for (int b = -reach; b <= reach; b++) {
+            for (int a = -reach; a <= reach; a++) {
+                float r2 = (a * a + b * b) * spacing * spacing;
+                if (r2 < kernels.h2 && r2 > 0.0f) {
+                    float r = std::sqrt(r2);
+                    float g = kernels.spiky * (kernels.h - r) * (kernels.h - r) / r;
+                    gradX += g * a * spacing;
+                    squares += g * g * r2;
+                }
+            }
+        }
+        float scale = mass / restDensity;
+        restGradient = scale * scale * (squares + gradX * gradX);
+        float dq2 = kernels.h2 - 0.04f * kernels.h2;
+        inverseCorrectionBase = 1.0f / (dq2 * dq2 * dq2);
+    }
+
+    void addBlock(float x0, float y0, float x1, float y1) {
+        for (float py = y0 + 0.5f * spacing; py < y1; py += spacing) {
+            for (float px = x0 + 0.5f * spacing; px < x1; px += spacing) {
+                if (!bounds.insideObstacle(px, py)) {
+                    x.push_back(px);
+                    y.push_back(py);
+                }
+            }
+        }
+        vx.resize(x.size(), 0.0f);
+        vy.resize(x.size(), 0.0f);
+    }
+
+    void addObstacle(float centerX, float centerY, float radius) {
+        bounds.obstacles.push_back(ParticleBounds::Obstacle{ centerX, centerY, radius });
+    }
+
+    void update(float timestep) {
+        if (x.empty()) {
+            return;
+        }
+        float fastest = 0.0f;
+        for (size_t k = 0; k < x.size(); k++) {
+            fastest = std::max(fastest, vx[k] * vx[k] + vy[k] * vy[k]);
+        }
+        fastest = std::sqrt(fastest) + gravity * timestep;
+
+        int substeps = int(std::ceil(timestep * fastest / (courant * kernels.h)));
+        substeps = std::min(maxSubsteps, std::max(minSubsteps, substeps));
+        float dt = timestep / substeps;
+        for (int s = 0; s < substeps; s++) {
+            substep(dt);
+        }
+        lastSubsteps = substeps;
+    }
+
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        snapshot.particleX.assign(x.begin(), x.end());
+        snapshot.particleY.assign(y.begin(), y.end());
+        snapshot.particleValue.resize(x.size());
+        for (size_t k = 0; k < x.size(); k++) {
+            snapshot.particleValue[k] = std::sqrt(vx[k] * vx[k] + vy[k] * vy[k]);
+        }
+    }
+
+    size_t getParticleCount() const {
+        return x.size();
+    }
+
+    int getSubsteps() const {
+        return lastSubsteps;
+    }
+
+    // Mean of max(rho / rho0 - 1, 0) as the last iteration measured it, before it applied
+    // its position correction; the error that correction leaves is not measured, which
+    // would take another neighbor pass.
+    float getDensityError() const {
+        return densityError;
+    }
+
+private:
+    static const size_t PARTICLE_GRAIN = 512;
+
+    float spacing;
+    ParticleKernels kernels;
+    float mass = 1.0f;
+    float restGradient = 1.0f;
+    float inverseCorrectionBase = 1.0f;
+    float densityError = 0.0f;
+    int lastSubsteps = 0;
+
+    // x, y are the positions at the start of the substep, px, py the predicted ones.
+    std::vector<float> x, y, vx, vy, px, py;
+    std::vector<float> lambda, dx, dy, constraint;
+    ParticleBounds bounds;
+    ParticleCellList cells;
+
+    void substep(float dt) {
+        size_t count = x.size();
+        px.resize(count);
+        py.resize(count);
+        JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                vy[i] += dt * gravity;
+                px[i] = x[i] + dt * vx[i];
+                py[i] = y[i] + dt * vy[i];
+                bounds.clamp(px[i], py[i]);
+            }
+        });
+
+        cells.build(px.data(), py.data(), count, kernels.h, bounds.width, bounds.height);
+        cells.reorder(x);
+        cells.reorder(y);
+        cells.reorder(vx);
+        cells.reorder(vy);
+        cells.reorder(px);
+        cells.reorder(py);
+
+        lambda.resize(count);
+        constraint.resize(count);
+        dx.resize(count);
+        dy.resize(count);
+        float epsilon = relaxation * restGradient;
+        for (int iteration = 0; iteration < iterations; iteration++) {
+            JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    float density = 0.0f, gradX = 0.0f, gradY = 0.0f, squares = 0.0f;
+                    cells.forNeighborRanges(px[i], py[i], [&](uint32_t first, uint32_t last) {
+                        constraintRange(i, first, last, density, gradX, gradY, squares);
+                    });
+                    float scale = mass / restDensity;
+                    float c = std::max(mass * kernels.poly6 * density / restDensity - 1.0f, 0.0f);
+                    float norm = scale * scale * (squares + gradX * gradX + gradY * gradY);
+                    constraint[i] = c;
+                    lambda[i] = -c / (norm + epsilon);
+                }
+            });
+            JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    float sumX = 0.0f, sumY = 0.0f;
+                    cells.forNeighborRanges(px[i], py[i], [&](uint32_t first, uint32_t last) {
+                        correctionRange(i, first, last, sumX, sumY);
+                    });
+                    float scale = mass / restDensity;
+                    dx[i] = scale * sumX;
+                    dy[i] = scale * sumY;
+                }
+            });
+            JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    px[i] += dx[i];
+                    py[i] += dy[i];
+                    bounds.clamp(px[i], py[i]);
+                }
+            });
+        }
+
+        float inverseDt = 1.0f / dt;
+        JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                vx[i] = (px[i] - x[i]) * inverseDt;
+                vy[i] = (py[i] - y[i]) * inverseDt;
+                float speed2 = vx[i] * vx[i] + vy[i] * vy[i];
+                if (speed2 > maxSpeed * maxSpeed) {
+                    float scale = maxSpeed / std::sqrt(speed2);
+                    vx[i] *= scale;
+                    vy[i] *= scale;
+                }
+            }
+        });
+
+        // XSPH reads the unsmoothed velocities, so it writes through dx, dy.
+        JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                float sumX = 0.0f, sumY = 0.0f;
+                cells.forNeighborRanges(px[i], py[i], [&](uint32_t first, uint32_t last) {
+                    for (uint32_t j = first; j < last; j++) {
+                        float ox = px[i] - px[j];
+                        float oy = py[i] - py[j];
+                        float d = std::max(kernels.h2 - (ox * ox + oy * oy), 0.0f);
+                        float w = d * d * d;
+                        sumX += (vx[j] - vx[i]) * w;
+                        sumY += (vy[j] - vy[i]) * w;
+                    }
+                });
+                float scale = xsph * mass * kernels.poly6 / restDensity;
+                dx[i] = vx[i] + scale * sumX;
+                dy[i] = vy[i] + scale * sumY;
+            }
+        });
+        vx.swap(dx);
+        vy.swap(dy);
+        x.swap(px);
+        y.swap(py);
+
+        double error = 0.0;
+        for (size_t i = 0; i < count; i++) {
+            error += constraint[i];
+        }
+        densityError = float(error / count);
+    }
+
+    // Density sum (h^2 - r^2)^3, the gradient of C_i with respect to p_i, and the sum of
+    // squared gradients with respect to each neighbor, all before the mass / rho0 factor.
+    void constraintRange(size_t i, uint32_t first, uint32_t last, float& density, float& gradX, float& gradY, float& squares) const {
+        float xi = px[i], yi = py[i];
+        float h = kernels.h, h2 = kernels.h2, spiky = kernels.spiky;
+        uint32_t j = first;
+#ifdef PARTICLE_FLUID_AVX2
+        __m256 accDensity = _mm256_setzero_ps();
+        __m256 accX = _mm256_setzero_ps();
+        __m256 accY = _mm256_setzero_ps();
+        __m256 accSquares = _mm256_setzero_ps();
+        __m256 vh = _mm256_set1_ps(h);
+        __m256 vh2 = _mm256_set1_ps(h2);
+        __m256 tiny = _mm256_set1_ps(1e-12f);
+        for (; j < last; j += 8) {
+            __m256i lanes = particleTailMask(last - j);
+            __m256 ox = _mm256_sub_ps(_mm256_set1_ps(xi), _mm256_maskload_ps(&px[j], lanes));
+            __m256 oy = _mm256_sub_ps(_mm256_set1_ps(yi), _mm256_maskload_ps(&py[j], lanes));
+            __m256 r2 = _mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy));
+            __m256 inside = _mm256_and_ps(_mm256_cmp_ps(r2, vh2, _CMP_LT_OQ), _mm256_castsi256_ps(lanes));
+            __m256 d = _mm256_and_ps(_mm256_sub_ps(vh2, r2), inside);
+            accDensity = _mm256_add_ps(accDensity, _mm256_mul_ps(_mm256_mul_ps(d, d), d));
+
+            __m256 valid = _mm256_and_ps(inside, _mm256_cmp_ps(r2, tiny, _CMP_GT_OQ));
+            __m256 r = _mm256_sqrt_ps(_mm256_max_ps(r2, tiny));
+            __m256 w = _mm256_sub_ps(vh, r);
+            __m256 g = _mm256_and_ps(_mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(spiky), _mm256_mul_ps(w, w)), r), valid);
+            accX = _mm256_add_ps(accX, _mm256_mul_ps(g, ox));
+            accY = _mm256_add_ps(accY, _mm256_mul_ps(g, oy));
+            accSquares = _mm256_add_ps(accSquares, _mm256_mul_ps(_mm256_mul_ps(g, g), r2));
+        }
+        density += particleHorizontalSum(accDensity);
+        gradX += particleHorizontalSum(accX);
+        gradY += particleHorizontalSum(accY);
+        squares += particleHorizontalSum(accSquares);
+#endif
+        for (; j < last; j++) {
+            float ox = xi - px[j];
+            float oy = yi - py[j];
+            float r2 = ox * ox + oy * oy;
+            if (r2 >= h2) {
+                continue;
+            }
+            float d = h2 - r2;
+            density += d * d * d;
+            if (r2 > 1e-12f) {
+                float r = std::sqrt(r2);
+                float g = spiky * (h - r) * (h - r) / r;
+                gradX += g * ox;
+                gradY += g * oy;
+                squares += g * g * r2;
+            }
+        }
+    }
+
+    // sum of (lambda_i + lambda_j + s_corr) times the spiky gradient, before mass / rho0.
+    void correctionRange(size_t i, uint32_t first, uint32_t last, float& sumX, float& sumY) const {
+        float xi = px[i], yi = py[i], li = lambda[i];
+        float h = kernels.h, h2 = kernels.h2, spiky = kernels.spiky;
+        float k = correctionScale;
+        float base = inverseCorrectionBase;
+        uint32_t j = first;
+#ifdef PARTICLE_FLUID_AVX2
+        __m256 accX = _mm256_setzero_ps();
+        __m256 accY = _mm256_setzero_ps();
+        __m256 vh = _mm256_set1_ps(h);
+        __m256 vh2 = _mm256_set1_ps(h2);
+        __m256 tiny = _mm256_set1_ps(1e-12f);
+        for (; j < last; j += 8) {
+            __m256i lanes = particleTailMask(last - j);
+            __m256 ox = _mm256_sub_ps(_mm256_set1_ps(xi), _mm256_maskload_ps(&px[j], lanes));
+            __m256 oy = _mm256_sub_ps(_mm256_set1_ps(yi), _mm256_maskload_ps(&py[j], lanes));
+            __m256 r2 = _mm256_add_ps(_mm256_mul_ps(ox, ox), _mm256_mul_ps(oy, oy));
+            __m256 valid = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(r2, vh2, _CMP_LT_OQ), _mm256_cmp_ps(r2, tiny, _CMP_GT_OQ)),
+                _mm256_castsi256_ps(lanes));
+            if (_mm256_movemask_ps(valid) == 0) {
+                continue;
+            }
+            __m256 d = _mm256_sub_ps(vh2, r2);
+            __m256 ratio = _mm256_mul_ps(_mm256_mul_ps(_mm256_mul_ps(d, d), d), _mm256_set1_ps(base));
+            __m256 ratio2 = _mm256_mul_ps(ratio, ratio);
+            __m256 correction = _mm256_mul_ps(_mm256_set1_ps(-k), _mm256_mul_ps(ratio2, ratio2));
+            __m256 total = _mm256_add_ps(_mm256_add_ps(_mm256_set1_ps(li), _mm256_maskload_ps(&lambda[j], lanes)), correction);
+            __m256 r = _mm256_sqrt_ps(_mm256_max_ps(r2, tiny));
+            __m256 w = _mm256_sub_ps(vh, r);
+            __m256 g = _mm256_div_ps(_mm256_mul_ps(_mm256_set1_ps(spiky), _mm256_mul_ps(w, w)), r);
+            __m256 factor = _mm256_and_ps(_mm256_mul_ps(total, g), valid);
+            accX = _mm256_add_ps(accX, _mm256_mul_ps(factor, ox));
+            accY = _mm256_add_ps(accY, _mm256_mul_ps(factor, oy));
+        }
+        // The gradient of W with respect to p_i points from j to i; -lambda pushes apart.
+        sumX -= particleHorizontalSum(accX);
+        sumY -= particleHorizontalSum(accY);
+#endif
+        for (; j < last; j++) {
+            float ox = xi - px[j];
+            float oy = yi - py[j];
+            float r2 = ox * ox + oy * oy;
+            if (r2 >= h2 || r2 <= 1e-12f) {
+                continue;
+            }
+            float d = h2 - r2;
+            float ratio = d * d * d * base;
+            float correction = -k * ratio * ratio * ratio * ratio;
+            float r = std::sqrt(r2);
+            float g = spiky * (h - r) * (h - r) / r;
+            float factor = (li + lambda[j] + correction) * g;
+            sumX -= factor * ox;
+            sumY -= factor * oy;
+        }
+    }
+};
+
+#endif
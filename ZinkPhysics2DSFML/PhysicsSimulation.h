@@ -9,6 +9,10 @@
 #include "RigidBody.h"
 #include "Vector2D.h"
 #include "Charts.h"
+#include "Telemetry.h"
+#include "World.h"
+#include "RenderSnapshot.h"
+#include "BodyRenderer.h"
 
 const float GRAVITY = 0.9f;
 const float DT = 0.5f;
@@ -19,25 +23,6 @@ float randomFloat(float min, float max) {
     return min + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (max - min)));
 }
 
-void checkBounds(RigidBody& ball, const sf::RenderWindow& window) {
-    if (ball.position.x - ball.radius < 0) {
-        ball.position.x = ball.radius;
-        ball.velocity.x = -ball.velocity.x;
-    }
-    if (ball.position.x + ball.radius > window.getSize().x) {
-        ball.position.x = window.getSize().x - ball.radius;
-        ball.velocity.x = -ball.velocity.x;
-    }
-    if (ball.position.y - ball.radius < 0) {
-        ball.position.y = ball.radius;
-        ball.velocity.y = -ball.velocity.y;
-    }
-    if (ball.position.y + ball.radius > window.getSize().y) {
-        ball.position.y = window.getSize().y - ball.radius;
-        ball.velocity.y = -ball.velocity.y;
-    }
-}
-
 void drawArrow(sf::RenderWindow& window, Vector2D start, Vector2D end, sf::Color color) {
     sf::Vertex line[] = {
         sf::Vertex(sf::Vector2f(start.x, start.y), color),
@@ -48,7 +33,8 @@ void drawArrow(sf::RenderWindow& window, Vector2D start, Vector2D end, sf::Color
 
 class PhysicsSimulation {
 public:
-    PhysicsSimulation() {
+    PhysicsSimulation()
+        : world(Vector2D(0, GRAVITY)) {
         srand(static_cast<unsigned int>(time(0)));
 
         for (int i = 0; i < NUM_OBJECTS; ++i) {
@@ -56,14 +42,11 @@ public:
             RigidBody ball(1.0f, position, RigidBody::ShapeType::Circle, 0.0f, 0.0f);
             ball.radius = 20.0f;
             ball.velocity = Vector2D(randomFloat(-50.0f, 50.0f), randomFloat(-50.0f, 50.0f));
-            objects.push_back(ball);
-
-            sf::CircleShape ballShape(ball.radius);
-            ballShape.setOrigin(ball.radius, ball.radius);
-            ballShape.setFillColor(sf::Color::Red);
-            shapes.push_back(ballShape);
+            world.addBody(ball);
         }
 
+        world.maxVelocity = MAX_VELOCITY;
+
         velocityChart = Chart(10, 10, 200, 100, "Velocity Chart", sf::Color::Blue);
         performanceChart = Chart(10, 120, 200, 100, "Performance Chart", sf::Color::Green);
         positionChart = Chart(220, 10, 200, 100, "Position Chart", sf::Color::Red);
@@ -71,46 +54,63 @@ public:
         forceChart = Chart(440, 10, 200, 100, "Force Chart", sf::Color::Magenta);
     }
 
-    void update(sf::RenderWindow& window) {
+    // Simulation thread.
+    void step(float width, float height) {
         sf::Clock clock;
 
-        for (auto& ball : objects) {
-            Vector2D gravity(0, GRAVITY * ball.mass);
-            ball.applyForce(gravity);
-            ball.update(DT);
-            checkBounds(ball, window);
-            velocityChart.addData(ball.velocity.length());
-            positionChart.addData(ball.position.y);
-            accelerationChart.addData(ball.velocity.length() / DT);
-            forceChart.addData(gravity.length());
-        }
+        world.setBounds(width, height);
+        world.step(DT);
 
-        for (size_t i = 0; i < objects.size(); ++i) {
-            for (size_t j = i + 1; j < objects.size(); ++j) {
-                if (objects[i].checkCollision(objects[j])) {
-                    objects[i].resolveCollision(objects[j]);
-                }
-            }
+        for (const auto& ball : world.getBodies()) {
+            float speed = ball.velocity.length();
+            series[Speed].add(speed);
+            series[Height].add(ball.position.y);
+            series[Acceleration].add(speed / DT);
+            series[Force].add(GRAVITY * ball.mass);
         }
+        series[StepTime].add(clock.getElapsedTime().asSeconds());
 
-        for (size_t i = 0; i < objects.size(); ++i) {
-            if (objects[i].velocity.length() > MAX_VELOCITY) {
-                objects[i].velocity = objects[i].velocity.normalized() * MAX_VELOCITY;
-            }
+        for (int channel = 0; channel < ChannelCount; ++channel) {
+            stepTelemetry[channel] = series[channel].commit();
         }
+    }
 
-        for (size_t i = 0; i < objects.size(); ++i) {
-            shapes[i].setPosition(objects[i].position.x, objects[i].position.y);
+    // Simulation thread, after step().
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        const std::vector<RigidBody>& objects = world.getBodies();
+        size_t count = objects.size();
+        snapshot.x.resize(count);
+        snapshot.y.resize(count);
+        snapshot.angle.resize(count);
+        snapshot.radius.resize(count);
+        snapshot.shape.resize(count);
+
+        for (size_t i = 0; i < count; ++i) {
+            snapshot.x[i] = objects[i].position.x;
+            snapshot.y[i] = objects[i].position.y;
+            snapshot.angle[i] = objects[i].angle;
+            snapshot.radius[i] = objects[i].radius;
+            snapshot.shape[i] = static_cast<uint8_t>(objects[i].shapeType);
         }
+        snapshot.telemetry.assign(stepTelemetry, stepTelemetry + ChannelCount);
+    }
 
-        performanceChart.addData(clock.getElapsedTime().asSeconds());
-
-        window.clear(sf::Color::White);
-
-        for (auto& shape : shapes) {
-            window.draw(shape);
+    // Render thread. Charts get one aggregated sample per published step.
+    void draw(sf::RenderWindow& window, const RenderSnapshot& snapshot, bool fresh) {
+        if (fresh) {
+            bodyRenderer.update(snapshot);
+
+            if (snapshot.telemetry.size() == ChannelCount) {
+                velocityChart.addSample(snapshot.telemetry[Speed]);
+                positionChart.addSample(snapshot.telemetry[Height]);
+                accelerationChart.addSample(snapshot.telemetry[Acceleration]);
+                forceChart.addSample(snapshot.telemetry[Force]);
+                performanceChart.addSample(snapshot.telemetry[StepTime]);
+            }
         }
 
+        bodyRenderer.draw(window);
+
         velocityChart.draw(window);
         performanceChart.draw(window);
         positionChart.draw(window);
@@ -118,9 +118,20 @@ public:
         forceChart.draw(window);
     }
 
+    void toggleStepMode() {
+        world.stepMode = world.stepMode == World::StepMode::Impulse ? World::StepMode::Substep : World::StepMode::Impulse;
+    }
+
 private:
-    std::vector<RigidBody> objects;
-    std::vector<sf::CircleShape> shapes;
+    enum TelemetryChannel { Speed, Height, Acceleration, Force, StepTime, ChannelCount };
+
+    // Owned by the simulation thread.
+    World world;
+    TelemetrySeries series[ChannelCount];
+    TelemetrySample stepTelemetry[ChannelCount];
+
+    // Owned by the render thread.
+    BodyRenderer bodyRenderer;
     Chart velocityChart, performanceChart, positionChart, accelerationChart, forceChart;
 };
 
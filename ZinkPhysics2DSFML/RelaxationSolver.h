@@ -0,0 +1,218 @@
+#ifndef RELAXATION_SOLVER_H
+#define RELAXATION_SOLVER_H
+
+#include <vector>
+#include <algorithm>
+#include "JobSystem.h"
+#include "Field2D.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define RELAXATION_SOLVER_AVX2 1
+#endif
+
+// Relaxes c * x = x0 + a * (sum of the four neighbors) on the interior of an N x N grid
+// (index i + j * N). Every method only ever reads cells that the current pass does not
+// write, so every row of a pass is independent: rows are split across the job system and
+// each row is processed eight cells at a time.
+//
+// Red-black Gauss-Seidel updates one checkerboard color per pass. The row kernel computes
+// all cells and stores only the active color through a lane mask, which doubles the
+// arithmetic but keeps the loads contiguous; the sweep is bound by memory either way.
+// The rows above and below belong to other jobs, so they are loaded through the same
+// mask: a lane active in this row is inactive in those, and the active cells they are
+// writing meanwhile are never touched, not even by a load whose result goes unused.
+// Weighted Jacobi writes into a scratch buffer and swaps, mostly useful for comparison.
+// Tiled Jacobi is the same update on Field2D copies of x and x0, one tile (and its ghost
+// ring) at a time; the layout conversion is paid once per solve, not per sweep.
+class RelaxationSolver {
+public:
+    enum class Method { RedBlackGaussSeidel, WeightedJacobi, TiledJacobi };
+
+    Method method = Method::RedBlackGaussSeidel;
+    float jacobiWeight = 2.0f / 3.0f;
+
+    // boundary() runs after every full sweep, like the original lexicographic loop.
+    // TiledJacobi needs the boundary as signs, see solveTiled; here it runs flat.
+    template <typename Boundary>
+    void solve(std::vector<float>& x, const std::vector<float>& x0, float a, float c, int N, int iterations, Boundary&& boundary) {
+        float invC = 1.0f / c;
+        for (int k = 0; k < iterations; k++) {
+            if (method != Method::RedBlackGaussSeidel) {
+                scratch.resize(x.size());
+                JobSystem::instance().parallelFor(1, N - 1, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+                    for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                        jacobiRow(scratch.data(), x.data(), x0.data(), a, invC, N, j);
+                    }
+                });
+                // Only the interior was written; carry the boundary over before swapping.
+                copyBorder(scratch, x, N);
+                std::swap(x, scratch);
+            }
+            else {
+                for (int color = 0; color < 2; color++) {
+                    JobSystem::instance().parallelFor(1, N - 1, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+                        for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                            redBlackRow(x.data(), x0.data(), a, invC, N, j, color);
+                        }
+                    });
+                }
+            }
+            boundary();
+        }
+    }
+
+    // Tiled sweeps cannot call back into the flat grid, so the fluid boundary is given as
+    // the signs Field2D::setBorder applies after every sweep.
+    void solveTiled(std::vector<float>& x, const std::vector<float>& x0, float a, float c, int N, int iterations, float rowSign, float columnSign) {
+        if (tiledX.width() != N || tiledX.height() != N) {
+            tiledX.resize(N, N);
+            tiledX0.resize(N, N);
+            tiledScratch.resize(N, N);
+        }
+        tiledX.copyFrom(x);
+        tiledX0.copyFrom(x0);
+
+        float invC = 1.0f / c;
+        float w = jacobiWeight;
+        for (int k = 0; k < iterations; k++) {
+            tiledX.updateGhosts();
+            JobSystem::instance().parallelFor(0, tiledX.tileCount(), 4, [&](size_t begin, size_t end) {
+                for (int t = int(begin); t < int(end); t++) {
+                    jacobiTile(tiledScratch.tile(t), tiledX.tile(t), tiledX0.tile(t), a, invC, w, N);
+                }
+            });
+            tiledX.swap(tiledScratch);
+            tiledX.setBorder(rowSign, columnSign);
+        }
+        tiledX.copyTo(x);
+    }
+
+private:
+    static const int ROW_GRAIN = 16;
+
+    typedef Field2D<16> TiledField;
+
+    std::vector<float> scratch;
+    TiledField tiledX, tiledX0, tiledScratch;
+
+    // Tiles share a slot order, so source, rhs and destination views line up cell for cell.
+    // Every row is relaxed across the full tile width, two AVX2 blocks or a constant trip
+    // count loop; cells outside the interior then get their old value back for setBorder.
+    static void jacobiTile(const TiledField::TileView& out, const TiledField::TileView& x, const TiledField::TileView& x0, float a, float invC, float w, int N) {
+        const int tile = TiledField::TILE;
+        int liBegin = x.x0 == 0 ? 1 : 0;
+        int liEnd = std::min(x.width, N - 1 - x.x0);
+        for (int lj = 0; lj < x.height; lj++) {
+            int j = x.y0 + lj;
+            const float* __restrict center = &x.at(0, lj);
+            float* __restrict target = &out.at(0, lj);
+            if (j == 0 || j == N - 1) {
+                std::copy(center, center + x.width, target);
+                continue;
+            }
+            const float* __restrict below = &x.at(0, lj - 1);
+            const float* __restrict above = &x.at(0, lj + 1);
+            const float* __restrict source = &x0.at(0, lj);
+#ifdef RELAXATION_SOLVER_AVX2
+            for (int li = 0; li < tile; li += 8) {
+                __m256 sum = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_loadu_ps(center + li - 1), _mm256_loadu_ps(center + li + 1)),
+                    _mm256_add_ps(_mm256_loadu_ps(below + li), _mm256_loadu_ps(above + li)));
+                __m256 relaxed = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(source + li), _mm256_mul_ps(_mm256_set1_ps(a), sum)), _mm256_set1_ps(invC));
+                _mm256_storeu_ps(target + li, _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(1.0f - w), _mm256_loadu_ps(center + li)),
+                    _mm256_mul_ps(_mm256_set1_ps(w), relaxed)));
+            }
+#else
+            for (int li = 0; li < tile; li++) {
+                float relaxed = (source[li] + a * (center[li - 1] + center[li + 1] + below[li] + above[li])) * invC;
+                target[li] = (1.0f - w) * center[li] + w * relaxed;
+            }
+#endif
+            for (int li = 0; li < liBegin; li++) {
+                target[li] = center[li];
+            }
+            for (int li = std::max(liEnd, 0); li < x.width; li++) {
+                target[li] = center[li];
+            }
+        }
+    }
+
+    static float relaxCell(const float* x, const float* x0, float a, float invC, int c, int N) {
+        return (x0[c] + a * (x[c - 1] + x[c + 1] + x[c - N] + x[c + N])) * invC;
+    }
+
+    // Cells with (i + j) & 1 == color are updated; color 0 is "red".
+    static void redBlackRow(float* x, const float* x0, float a, float invC, int N, int j, int color) {
+        int row = j * N;
+        int i = 1;
+#ifdef RELAXATION_SOLVER_AVX2
+        __m256 va = _mm256_set1_ps(a);
+        __m256 vInvC = _mm256_set1_ps(invC);
+        // i starts at 1 and steps by 8, so lane k always has the parity of 1 + k.
+        bool evenLanesActive = ((1 + j) & 1) == color;
+        __m256i activeLanes = evenLanesActive ? _mm256_setr_epi32(-1, 0, -1, 0, -1, 0, -1, 0)
+                                              : _mm256_setr_epi32(0, -1, 0, -1, 0, -1, 0, -1);
+        if (i + 8 <= N - 1) {
+            // The next block's row loads are issued before this block's store. Its left
+            // load overlaps our last lane, which would otherwise stall store forwarding;
+            // that lane and the next block's first lane never share a color, so reading
+            // the old value is still correct.
+            __m256 left = _mm256_loadu_ps(x + row + i - 1);
+            __m256 right = _mm256_loadu_ps(x + row + i + 1);
+            for (; i + 8 <= N - 1; i += 8) {
+                int c = row + i;
+                __m256 sum = _mm256_add_ps(_mm256_add_ps(left, right),
+                    _mm256_add_ps(_mm256_maskload_ps(x + c - N, activeLanes), _mm256_maskload_ps(x + c + N, activeLanes)));
+                __m256 relaxed = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(x0 + c), _mm256_mul_ps(va, sum)), vInvC);
+                if (i + 16 <= N - 1) {
+                    left = _mm256_loadu_ps(x + c + 7);
+                    right = _mm256_loadu_ps(x + c + 9);
+                }
+                _mm256_maskstore_ps(x + c, activeLanes, relaxed);
+            }
+        }
+#endif
+        if (((i + j) & 1) != color) {
+            i++;
+        }
+        for (; i < N - 1; i += 2) {
+            x[row + i] = relaxCell(x, x0, a, invC, row + i, N);
+        }
+    }
+
+    void jacobiRow(float* out, const float* x, const float* x0, float a, float invC, int N, int j) const {
+        int row = j * N;
+        float w = jacobiWeight;
+        int i = 1;
+#ifdef RELAXATION_SOLVER_AVX2
+        __m256 va = _mm256_set1_ps(a);
+        __m256 vInvC = _mm256_set1_ps(invC);
+        __m256 vw = _mm256_set1_ps(w);
+        __m256 vKeep = _mm256_set1_ps(1.0f - w);
+        for (; i + 8 <= N - 1; i += 8) {
+            int c = row + i;
+            __m256 sum = _mm256_add_ps(
+                _mm256_add_ps(_mm256_loadu_ps(x + c - 1), _mm256_loadu_ps(x + c + 1)),
+                _mm256_add_ps(_mm256_loadu_ps(x + c - N), _mm256_loadu_ps(x + c + N)));
+            __m256 relaxed = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(x0 + c), _mm256_mul_ps(va, sum)), vInvC);
+            _mm256_storeu_ps(out + c, _mm256_add_ps(_mm256_mul_ps(vKeep, _mm256_loadu_ps(x + c)), _mm256_mul_ps(vw, relaxed)));
+        }
+#endif
+        for (; i < N - 1; i++) {
+            int c = row + i;
+            out[c] = (1.0f - w) * x[c] + w * relaxCell(x, x0, a, invC, c, N);
+        }
+    }
+
+    static void copyBorder(std::vector<float>& destination, const std::vector<float>& source, int N) {
+        std::copy(source.begin(), source.begin() + N, destination.begin());
+        std::copy(source.end() - N, source.end(), destination.end() - N);
+        for (int j = 1; j < N - 1; j++) {
+            destination[j * N] = source[j * N];
+            destination[j * N + N - 1] = source[j * N + N - 1];
+        }
+    }
+};
+
+#endif
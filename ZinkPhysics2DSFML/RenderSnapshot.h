@@ -0,0 +1,43 @@
+#ifndef RENDER_SNAPSHOT_H
+#define RENDER_SNAPSHOT_H
+
+#include <vector>
+#include <cstdint>
+#include "Telemetry.h"
+
+enum class VisualizationType {
+    FluidSimulation,
+    PhysicsSimulation,
+    SparseFluidSimulation,
+    AdaptiveFluidSimulation,
+    FlipFluidSimulation,
+    SphFluidSimulation,
+    PbfFluidSimulation,
+    LbmFluidSimulation,
+    ShallowWaterSimulation,
+    TurbulentFluidSimulation,
+    CoupledSimulation,
+    TracerSimulation
+};
+
+// Everything the render thread needs for one frame, written by the simulation thread
+// and read-only once published. Vectors keep their capacity between frames.
+struct RenderSnapshot {
+    VisualizationType visualization = VisualizationType::FluidSimulation;
+    uint64_t step = 0;
+
+    std::vector<float> x, y, angle, radius;
+    std::vector<uint8_t> shape;
+
+    int fluidSize = 0;
+    std::vector<float> density, u, v;
+    std::vector<uint8_t> solid;
+
+    // Particle views: positions in window pixels and a value mapped to color.
+    std::vector<float> particleX, particleY, particleValue;
+
+    // Per-step aggregates; the channel layout is defined by the simulation that wrote them.
+    std::vector<TelemetrySample> telemetry;
+};
+
+#endif
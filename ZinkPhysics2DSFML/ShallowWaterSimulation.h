@@ -0,0 +1,238 @@
+#ifndef SHALLOW_WATER_SIMULATION_H
+#define SHALLOW_WATER_SIMULATION_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <SFML/System/Clock.hpp>
+#include "JobSystem.h"
+#include "RenderSnapshot.h"
+#include "FluidSimulation.h"
+
+// Shallow-water equations over terrain, in meters and seconds. Each cell holds a water
+// depth h over a terrain height b; velocities live on the faces (u on the vertical faces,
+// v on the horizontal ones), so the surface slope drives them directly and the depth is
+// updated from face fluxes, which conserves water exactly.
+//
+// A face is wet only while the higher water surface on either side reaches above the
+// terrain on both, so water runs up and off slopes instead of leaking through them.
+// Before the depth update each cell's outgoing flux is scaled down to at most the water
+// it holds, which keeps h non-negative at any wet/dry front.
+//
+// update() splits the frame into as many substeps as the CFL limit on |u| + sqrt(g h)
+// requires. Every pass is one parallel sweep over rows. Momentum advection is left out:
+// for the waves this is meant for, flow speeds are small next to the wave speed.
+class ShallowWaterSimulation {
+public:
+    float gravity = 9.81f;
+    float friction = 0.02f; // linear bed drag, 1 / seconds
+    float courant = 0.5f;
+    int maxSubsteps = 16;
+    float waveScale = 0.5f; // surface displacement, in meters, shown at the ends of the colormap
+
+    // gridSize x gridSize cells of cellSize meters, flat terrain at height zero, dry.
+    ShallowWaterSimulation(int gridSize, float cellSize)
+        : N(gridSize), dx(cellSize), h(N * N, 0.0f), b(N * N, 0.0f), u((N + 1) * N, 0.0f), v(N * (N + 1), 0.0f),
+        outflowScale(N * N, 1.0f), rowSpeed(N, 0.0f) {
+    }
+
+    // Raises the terrain by a smooth bump of the given peak height, in cells.
+    void addHill(float centerX, float centerY, float radius, float height) {
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < N; i++) {
+                float dxCell = i + 0.5f - centerX;
+                float dyCell = j + 0.5f - centerY;
+                float r = std::sqrt(dxCell * dxCell + dyCell * dyCell) / radius;
+                if (r < 1.0f) {
+                    float raise = height * 0.5f * (1.0f + std::cos(3.14159265f * r));
+                    b[i + j * N] += raise;
+                    h[i + j * N] = std::max(h[i + j * N] - raise, 0.0f);
+                }
+            }
+        }
+    }
+
+    // Fills every cell up to the given surface level and stops all flow.
+    void fill(float level) {
+        seaLevel = level;
+        for (int cell = 0; cell < N * N; cell++) {
+            h[cell] = std::max(level - b[cell], 0.0f);
+        }
+        std::fill(u.begin(), u.end(), 0.0f);
+        std::fill(v.begin(), v.end(), 0.0f);
+        updateWaveSpeed();
+    }
+
+    // Adds a smooth mound of water on top of whatever is there, in cells and meters.
+    void addDrop(float centerX, float centerY, float radius, float height) {
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < N; i++) {
+                float dxCell = i + 0.5f - centerX;
+                float dyCell = j + 0.5f - centerY;
+                float r = std::sqrt(dxCell * dxCell + dyCell * dyCell) / radius;
+                if (r < 1.0f) {
+                    h[i + j * N] += height * 0.5f * (1.0f + std::cos(3.14159265f * r));
+                }
+            }
+        }
+        updateWaveSpeed();
+    }
+
+    void update(float timestep) {
+        sf::Clock clock;
+
+        // Past maxSubsteps the rest of the frame is dropped: slow motion rather than a stall.
+        float remaining = timestep;
+        int substeps = 0;
+        while (remaining > 0.0f && substeps < maxSubsteps) {
+            float dt = std::min(remaining, courant * dx / std::max(maxWaveSpeed, 1e-3f));
+            substep(dt);
+            remaining -= dt;
+            substeps++;
+        }
+        lastSubsteps = substeps;
+
+        series[FluidSimulation::StepTime].add(clock.getElapsedTime().asSeconds());
+        for (int channel = 0; channel < FluidSimulation::ChannelCount; ++channel) {
+            stepTelemetry[channel] = series[channel].commit();
+        }
+    }
+
+    // The density view shows the surface around sea level, dry cells are drawn as solid
+    // and the speed view uses the face velocities averaged to cell centers.
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        snapshot.fluidSize = N;
+        snapshot.density.resize(N * N);
+        snapshot.u.resize(N * N);
+        snapshot.v.resize(N * N);
+        snapshot.solid.resize(N * N);
+
+        float surfaceScale = 0.5f / waveScale;
+        JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 0; i < N; i++) {
+                    int cell = i + j * N;
+                    bool dry = h[cell] <= DRY_DEPTH;
+                    snapshot.solid[cell] = dry ? 1 : 0;
+                    snapshot.density[cell] = dry ? 0.0f : 0.5f + (h[cell] + b[cell] - seaLevel) * surfaceScale;
+                    snapshot.u[cell] = 0.5f * (u[i + j * (N + 1)] + u[i + 1 + j * (N + 1)]);
+                    snapshot.v[cell] = 0.5f * (v[cell] + v[cell + N]);
+                }
+            }
+        });
+        snapshot.telemetry.assign(stepTelemetry, stepTelemetry + FluidSimulation::ChannelCount);
+    }
+
+    double getTotalVolume() const {
+        double sum = 0.0;
+        for (float depth : h) {
+            sum += depth;
+        }
+        return sum * dx * dx;
+    }
+
+    int getSubsteps() const {
+        return lastSubsteps;
+    }
+
+private:
+    static const int ROW_GRAIN = 16;
+    static constexpr float DRY_DEPTH = 1e-3f;
+
+    int N;
+    float dx;
+    float seaLevel = 0.0f;
+    float maxWaveSpeed = 0.0f;
+    int lastSubsteps = 0;
+
+    // h, b at cell centers; u[i + j * (N + 1)] on the face left of cell i, v[i + j * N]
+    // on the face above cell row j. The outer faces stay closed.
+    std::vector<float> h, b, u, v;
+    std::vector<float> outflowScale, newDepth;
+    std::vector<float> rowSpeed;
+    TelemetrySeries series[FluidSimulation::ChannelCount];
+    TelemetrySample stepTelemetry[FluidSimulation::ChannelCount];
+
+    // Surface-slope acceleration on the face between cells a and c; zero when the water
+    // on the higher side does not reach over the terrain on the other.
+    float faceVelocity(float velocity, int a, int c, float dt) const {
+        float surfaceA = h[a] + b[a];
+        float surfaceC = h[c] + b[c];
+        float top = std::max(surfaceA, surfaceC);
+        if (top - std::max(b[a], b[c]) <= DRY_DEPTH) {
+            return 0.0f;
+        }
+        velocity -= gravity * dt * (surfaceC - surfaceA) / dx;
+        return velocity / (1.0f + friction * dt);
+    }
+
+    void substep(float dt) {
+        JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                float* row = &u[j * (N + 1)];
+                for (int i = 1; i < N; i++) {
+                    row[i] = faceVelocity(row[i], i - 1 + j * N, i + j * N, dt);
+                }
+                if (j > 0) {
+                    for (int i = 0; i < N; i++) {
+                        v[i + j * N] = faceVelocity(v[i + j * N], i + (j - 1) * N, i + j * N, dt);
+                    }
+                }
+            }
+        });
+
+        // Fraction of each cell's outgoing flux it can actually supply this substep.
+        float rate = dt / dx;
+        JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 0; i < N; i++) {
+                    int cell = i + j * N;
+                    float out = std::max(u[i + 1 + j * (N + 1)], 0.0f) - std::min(u[i + j * (N + 1)], 0.0f)
+                        + std::max(v[cell + N], 0.0f) - std::min(v[cell], 0.0f);
+                    float leaving = out * rate * h[cell];
+                    outflowScale[cell] = leaving > h[cell] ? h[cell] / leaving : 1.0f;
+                }
+            }
+        });
+
+        // Upwind depth times velocity on every face, then the depth change; h is only
+        // written for the cell being updated, and every flux reads the old depths.
+        newDepth.resize(N * N);
+        JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                float fastest = 0.0f;
+                for (int i = 0; i < N; i++) {
+                    int cell = i + j * N;
+                    float left = i > 0 ? flux(u[i + j * (N + 1)], cell - 1, cell) : 0.0f;
+                    float right = i < N - 1 ? flux(u[i + 1 + j * (N + 1)], cell, cell + 1) : 0.0f;
+                    float up = j > 0 ? flux(v[cell], cell - N, cell) : 0.0f;
+                    float down = j < N - 1 ? flux(v[cell + N], cell, cell + N) : 0.0f;
+                    float depth = std::max(h[cell] - rate * (right - left + down - up), 0.0f);
+                    newDepth[cell] = depth;
+
+                    float flow = std::max(std::abs(u[i + j * (N + 1)]), std::abs(v[cell]));
+                    fastest = std::max(fastest, flow + std::sqrt(gravity * depth));
+                }
+                rowSpeed[j] = fastest;
+            }
+        });
+        h.swap(newDepth);
+        maxWaveSpeed = *std::max_element(rowSpeed.begin(), rowSpeed.end());
+    }
+
+    // Volume flux per unit width through a face from cell a to cell c.
+    float flux(float velocity, int a, int c) const {
+        return velocity > 0.0f ? velocity * h[a] * outflowScale[a] : velocity * h[c] * outflowScale[c];
+    }
+
+    void updateWaveSpeed() {
+        float fastest = 0.0f;
+        for (float depth : h) {
+            fastest = std::max(fastest, std::sqrt(gravity * depth));
+        }
+        maxWaveSpeed = fastest;
+    }
+};
+
+#endif
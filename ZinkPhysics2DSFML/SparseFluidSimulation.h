@@ -0,0 +1,432 @@
+#ifndef SPARSE_FLUID_SIMULATION_H
+#define SPARSE_FLUID_SIMULATION_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <SFML/System/Clock.hpp>
+#include "JobSystem.h"
+#include "RenderSnapshot.h"
+#include "FluidSimulation.h"
+
+// Stable Fluids on a sparse block grid: the N x N domain is cut into 16 x 16 tiles and
+// only tiles near fluid are allocated and stepped. A tile stays active while its density
+// or speed is above a threshold, plus a band of `dilation` tiles around those so motion
+// has room to spread; everything else is unallocated and reads as zero (still fluid at
+// rest, pressure 0). Memory and step time follow the wet area, not N * N.
+//
+// The passes are the same as FluidSimulation's, except that pressure outside the active
+// region is held at zero instead of solved for, as in an open domain.
+class SparseFluidSimulation {
+public:
+    static const int TILE = 16;
+    static const int HALO = TILE + 2;
+
+    float densityThreshold = 1e-3f;
+    float velocityThreshold = 0.25f;
+    int dilation = 1;
+    float gravity = 9.8f;
+    float diffusion = 0.0f;
+    int solverIterations = 20;
+
+    SparseFluidSimulation(int gridSize, float vis)
+        : N(gridSize), viscosity(vis), tilesX((gridSize + TILE - 1) / TILE),
+        blockOf(tilesX * tilesX, -1), wet(tilesX * tilesX, 0), keep(tilesX * tilesX, 0) {
+        for (int f = 0; f < FIELD_COUNT; f++) {
+            slot[f] = f;
+        }
+    }
+
+    // Sets density in a disc and activates the tiles it touches.
+    void addDensity(int centerX, int centerY, int radius, float amount) {
+        for (int j = std::max(1, centerY - radius); j <= std::min(N - 2, centerY + radius); j++) {
+            for (int i = std::max(1, centerX - radius); i <= std::min(N - 2, centerX + radius); i++) {
+                int dx = i - centerX;
+                int dy = j - centerY;
+                if (dx * dx + dy * dy <= radius * radius) {
+                    int tile = tileOf(i, j);
+                    if (blockOf[tile] < 0) {
+                        allocate(tile);
+                        active.push_back(tile);
+                    }
+                    ref(DENSITY, i, j) = amount;
+                }
+            }
+        }
+        refreshActiveSet();
+    }
+
+    void update(float timestep) {
+        sf::Clock clock;
+
+        velocityStep(timestep);
+        densityStep(timestep);
+        refreshActiveSet();
+
+        series[FluidSimulation::StepTime].add(clock.getElapsedTime().asSeconds());
+        for (int channel = 0; channel < FluidSimulation::ChannelCount; ++channel) {
+            stepTelemetry[channel] = series[channel].commit();
+        }
+    }
+
+    // Expands to the dense layout FluidRenderer draws; inactive cells are zero.
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        size_t cells = static_cast<size_t>(N) * N;
+        snapshot.fluidSize = N;
+        snapshot.density.assign(cells, 0.0f);
+        snapshot.u.assign(cells, 0.0f);
+        snapshot.v.assign(cells, 0.0f);
+        snapshot.solid.clear();
+        for (int tile : active) {
+            int x0 = (tile % tilesX) * TILE;
+            int y0 = (tile / tilesX) * TILE;
+            for (int j = y0; j < std::min(y0 + TILE, N); j++) {
+                for (int i = x0; i < std::min(x0 + TILE, N); i++) {
+                    snapshot.density[i + j * N] = get(DENSITY, i, j);
+                    snapshot.u[i + j * N] = get(U, i, j);
+                    snapshot.v[i + j * N] = get(V, i, j);
+                }
+            }
+        }
+        snapshot.telemetry.assign(stepTelemetry, stepTelemetry + FluidSimulation::ChannelCount);
+    }
+
+    int getActiveTileCount() const {
+        return int(active.size());
+    }
+
+    // High-water mark: released blocks are recycled, not returned to the allocator.
+    size_t getAllocatedBytes() const {
+        return blocks.size() * sizeof(Block) + blockOf.size() * sizeof(int);
+    }
+
+private:
+    enum Field { U, V, U_PREV, V_PREV, PRESSURE, DIVERGENCE, DENSITY, DENSITY_PREV, FIELD_COUNT };
+
+    // Same convention as FluidSimulation::setBoundary.
+    static const int BOUNDARY_SCALAR = 0;
+    static const int BOUNDARY_V = 1;
+    static const int BOUNDARY_U = 2;
+
+    struct Block {
+        float cells[FIELD_COUNT][TILE * TILE];
+    };
+
+    int N;
+    float viscosity;
+    int tilesX;
+    std::vector<int> blockOf;   // tile -> block, -1 when not allocated
+    std::vector<Block> blocks;
+    std::vector<int> freeBlocks;
+    std::vector<int> active;    // allocated tiles, the only ones any pass visits
+    std::vector<uint8_t> wet;   // per active slot; sized for every tile so it never grows
+    std::vector<uint8_t> keep;
+    int slot[FIELD_COUNT];      // logical field -> storage, so swaps are free
+
+    TelemetrySeries series[FluidSimulation::ChannelCount];
+    TelemetrySample stepTelemetry[FluidSimulation::ChannelCount];
+
+    int tileOf(int i, int j) const {
+        return i / TILE + (j / TILE) * tilesX;
+    }
+
+    float& ref(int field, int i, int j) {
+        return blocks[blockOf[tileOf(i, j)]].cells[slot[field]][(j % TILE) * TILE + i % TILE];
+    }
+
+    float get(int field, int i, int j) const {
+        if (i < 0 || j < 0 || i >= N || j >= N) {
+            return 0.0f;
+        }
+        int block = blockOf[tileOf(i, j)];
+        return block < 0 ? 0.0f : blocks[block].cells[slot[field]][(j % TILE) * TILE + i % TILE];
+    }
+
+    void swapFields(int a, int b) {
+        std::swap(slot[a], slot[b]);
+    }
+
+    void allocate(int tile) {
+        int block;
+        if (!freeBlocks.empty()) {
+            block = freeBlocks.back();
+            freeBlocks.pop_back();
+        }
+        else {
+            block = int(blocks.size());
+            blocks.emplace_back();
+        }
+        std::fill(&blocks[block].cells[0][0], &blocks[block].cells[0][0] + FIELD_COUNT * TILE * TILE, 0.0f);
+        blockOf[tile] = block;
+    }
+
+    // Runs body(tile, block, x0, y0) for every active tile, tiles spread over jobs.
+    template <typename Body>
+    void forActiveTiles(Body&& body) {
+        JobSystem::instance().parallelFor(0, active.size(), 1, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; t++) {
+                int tile = active[t];
+                body(tile, blocks[blockOf[tile]], (tile % tilesX) * TILE, (tile / tilesX) * TILE);
+            }
+        });
+    }
+
+    // Runs body(i, j) for every interior cell of every active tile.
+    template <typename Body>
+    void forActiveCells(Body&& body) {
+        forActiveTiles([&](int, Block&, int x0, int y0) {
+            for (int j = std::max(y0, 1); j < std::min(y0 + TILE, N - 1); j++) {
+                for (int i = std::max(x0, 1); i < std::min(x0 + TILE, N - 1); i++) {
+                    body(i, j);
+                }
+            }
+        });
+    }
+
+    // Copies one field of a tile plus a one-cell ring from the neighboring tiles into a
+    // HALO x HALO buffer, so stencils index it directly. Unallocated neighbors read zero.
+    // Ring cells of color skipColor ((i + j) & 1) are left unread: a red-black pass has
+    // the neighbors writing exactly those cells while this tile gathers.
+    void gatherHalo(int field, int tile, float* halo, int skipColor = -1) const {
+        int tx = tile % tilesX;
+        int ty = tile / tilesX;
+        int x0 = tx * TILE;
+        int y0 = ty * TILE;
+        auto readable = [&](int i, int j) {
+            return ((i + j) & 1) != skipColor;
+        };
+        const float* self = blocks[blockOf[tile]].cells[slot[field]];
+        const float* left = tx > 0 ? fieldOf(field, tile - 1) : nullptr;
+        const float* right = tx + 1 < tilesX ? fieldOf(field, tile + 1) : nullptr;
+        const float* below = ty > 0 ? fieldOf(field, tile - tilesX) : nullptr;
+        const float* above = ty + 1 < tilesX ? fieldOf(field, tile + tilesX) : nullptr;
+
+        for (int lj = 0; lj < TILE; lj++) {
+            float* row = halo + (lj + 1) * HALO;
+            std::copy(self + lj * TILE, self + (lj + 1) * TILE, row + 1);
+            row[0] = left && readable(x0 - 1, y0 + lj) ? left[lj * TILE + TILE - 1] : 0.0f;
+            row[TILE + 1] = right && readable(x0 + TILE, y0 + lj) ? right[lj * TILE] : 0.0f;
+        }
+        for (int li = 0; li < TILE; li++) {
+            halo[li + 1] = below && readable(x0 + li, y0 - 1) ? below[(TILE - 1) * TILE + li] : 0.0f;
+            halo[(TILE + 1) * HALO + li + 1] = above && readable(x0 + li, y0 + TILE) ? above[li] : 0.0f;
+        }
+    }
+
+    const float* fieldOf(int field, int tile) const {
+        int block = blockOf[tile];
+        return block < 0 ? nullptr : blocks[block].cells[slot[field]];
+    }
+
+    // FluidSimulation::setBoundary restricted to the wall cells of active tiles.
+    void setBorder(int b, int field) {
+        for (int tile : active) {
+            int x0 = (tile % tilesX) * TILE;
+            int y0 = (tile / tilesX) * TILE;
+            int x1 = std::min(x0 + TILE, N);
+            int y1 = std::min(y0 + TILE, N);
+            for (int i = std::max(x0, 1); i < std::min(x1, N - 1); i++) {
+                if (y0 == 0) ref(field, i, 0) = b == 1 ? -get(field, i, 1) : get(field, i, 1);
+                if (y1 == N) ref(field, i, N - 1) = b == 1 ? -get(field, i, N - 2) : get(field, i, N - 2);
+            }
+            for (int j = std::max(y0, 1); j < std::min(y1, N - 1); j++) {
+                if (x0 == 0) ref(field, 0, j) = b == 2 ? -get(field, 1, j) : get(field, 1, j);
+                if (x1 == N) ref(field, N - 1, j) = b == 2 ? -get(field, N - 2, j) : get(field, N - 2, j);
+            }
+        }
+
+        // Corners average their two wall neighbors, once the walls are set.
+        const int corners[4][6] = {
+            { 0, 0, 1, 0, 0, 1 },
+            { N - 1, 0, N - 2, 0, N - 1, 1 },
+            { 0, N - 1, 0, N - 2, 1, N - 1 },
+            { N - 1, N - 1, N - 2, N - 1, N - 1, N - 2 }
+        };
+        for (const int* corner : corners) {
+            if (blockOf[tileOf(corner[0], corner[1])] >= 0) {
+                ref(field, corner[0], corner[1]) = 0.5f * (get(field, corner[2], corner[3]) + get(field, corner[4], corner[5]));
+            }
+        }
+    }
+
+    // Red-black Gauss-Seidel on c * x = x0 + a * neighbors over the active cells. A color
+    // pass only reads the other color, so each tile can work from a halo snapshot of it.
+    void relax(int b, int x, int x0, float a, float c) {
+        float invC = 1.0f / c;
+        for (int k = 0; k < solverIterations; k++) {
+            for (int color = 0; color < 2; color++) {
+                forActiveTiles([&](int tile, Block& block, int tileX, int tileY) {
+                    float halo[HALO * HALO];
+                    gatherHalo(x, tile, halo, color);
+                    float* out = block.cells[slot[x]];
+                    const float* rhs = block.cells[slot[x0]];
+                    int iBegin = std::max(tileX, 1) - tileX;
+                    int iEnd = std::min(tileX + TILE, N - 1) - tileX;
+                    for (int lj = std::max(tileY, 1) - tileY; lj < std::min(tileY + TILE, N - 1) - tileY; lj++) {
+                        int first = iBegin + (((tileX + iBegin + tileY + lj) & 1) != color ? 1 : 0);
+                        for (int li = first; li < iEnd; li += 2) {
+                            int h = (lj + 1) * HALO + li + 1;
+                            out[lj * TILE + li] = (rhs[lj * TILE + li] + a * (halo[h - 1] + halo[h + 1] + halo[h - HALO] + halo[h + HALO])) * invC;
+                        }
+                    }
+                });
+            }
+            setBorder(b, x);
+        }
+    }
+
+    // diff is in cells^2 per second, as in FluidSimulation.
+    void diffuse(int b, int x, int x0, float diff, float dt) {
+        float a = dt * diff;
+        if (a <= 0.0f) {
+            forActiveTiles([&](int, Block& block, int, int) {
+                std::copy(block.cells[slot[x0]], block.cells[slot[x0]] + TILE * TILE, block.cells[slot[x]]);
+            });
+            return;
+        }
+        relax(b, x, x0, a, 1 + 4 * a);
+    }
+
+    void project() {
+        forActiveTiles([&](int tile, Block& block, int tileX, int tileY) {
+            float haloU[HALO * HALO], haloV[HALO * HALO];
+            gatherHalo(U, tile, haloU);
+            gatherHalo(V, tile, haloV);
+            float* divergence = block.cells[slot[DIVERGENCE]];
+            float* pressure = block.cells[slot[PRESSURE]];
+            forTileInterior(tileX, tileY, [&](int c, int h) {
+                divergence[c] = -0.5f * (haloU[h + 1] - haloU[h - 1] + haloV[h + HALO] - haloV[h - HALO]);
+                pressure[c] = 0.0f;
+            });
+        });
+        setBorder(BOUNDARY_SCALAR, DIVERGENCE);
+        setBorder(BOUNDARY_SCALAR, PRESSURE);
+
+        relax(BOUNDARY_SCALAR, PRESSURE, DIVERGENCE, 1.0f, 4.0f);
+
+        forActiveTiles([&](int tile, Block& block, int tileX, int tileY) {
+            float haloP[HALO * HALO];
+            gatherHalo(PRESSURE, tile, haloP);
+            float* u = block.cells[slot[U]];
+            float* v = block.cells[slot[V]];
+            forTileInterior(tileX, tileY, [&](int c, int h) {
+                u[c] -= 0.5f * (haloP[h + 1] - haloP[h - 1]);
+                v[c] -= 0.5f * (haloP[h + HALO] - haloP[h - HALO]);
+            });
+        });
+        setBorder(BOUNDARY_U, U);
+        setBorder(BOUNDARY_V, V);
+    }
+
+    // body(cell index in the block, index in a halo buffer) for the tile's interior cells.
+    template <typename Body>
+    void forTileInterior(int tileX, int tileY, Body&& body) const {
+        int iBegin = std::max(tileX, 1) - tileX;
+        int iEnd = std::min(tileX + TILE, N - 1) - tileX;
+        for (int lj = std::max(tileY, 1) - tileY; lj < std::min(tileY + TILE, N - 1) - tileY; lj++) {
+            for (int li = iBegin; li < iEnd; li++) {
+                body(lj * TILE + li, (lj + 1) * HALO + li + 1);
+            }
+        }
+    }
+
+    void advect(int b, int d, int d0, int uField, int vField, float dt) {
+        forActiveCells([&](int i, int j) {
+            float x = i - dt * get(uField, i, j);
+            float y = j - dt * get(vField, i, j);
+
+            x = std::max(0.5f, std::min(x, float(N - 1.5f)));
+            y = std::max(0.5f, std::min(y, float(N - 1.5f)));
+
+            int i0 = int(x);
+            int j0 = int(y);
+            float s1 = x - i0;
+            float s0 = 1.0f - s1;
+            float t1 = y - j0;
+            float t0 = 1.0f - t1;
+
+            ref(d, i, j) = s0 * (t0 * get(d0, i0, j0) + t1 * get(d0, i0, j0 + 1)) +
+                s1 * (t0 * get(d0, i0 + 1, j0) + t1 * get(d0, i0 + 1, j0 + 1));
+        });
+        setBorder(b, d);
+    }
+
+    void velocityStep(float dt) {
+        forActiveTiles([&](int, Block& block, int tileX, int tileY) {
+            float* v = block.cells[slot[V]];
+            const float* density = block.cells[slot[DENSITY]];
+            forTileInterior(tileX, tileY, [&](int c, int) {
+                v[c] += gravity * density[c] * dt;
+            });
+        });
+
+        swapFields(U, U_PREV);
+        diffuse(BOUNDARY_U, U, U_PREV, viscosity, dt);
+        swapFields(V, V_PREV);
+        diffuse(BOUNDARY_V, V, V_PREV, viscosity, dt);
+        project();
+
+        swapFields(U, U_PREV);
+        swapFields(V, V_PREV);
+        advect(BOUNDARY_U, U, U_PREV, U_PREV, V_PREV, dt);
+        advect(BOUNDARY_V, V, V_PREV, U_PREV, V_PREV, dt);
+        project();
+    }
+
+    void densityStep(float dt) {
+        swapFields(DENSITY, DENSITY_PREV);
+        diffuse(BOUNDARY_SCALAR, DENSITY, DENSITY_PREV, diffusion, dt);
+        swapFields(DENSITY, DENSITY_PREV);
+        advect(BOUNDARY_SCALAR, DENSITY, DENSITY_PREV, U, V, dt);
+    }
+
+    // Marks tiles whose density or speed is above threshold, dilates the marks by
+    // `dilation` tiles, allocates what is newly covered and recycles what is not.
+    void refreshActiveSet() {
+        std::fill(wet.begin(), wet.begin() + active.size(), 0);
+        JobSystem::instance().parallelFor(0, active.size(), 4, [&](size_t begin, size_t end) {
+            for (size_t t = begin; t < end; t++) {
+                const Block& block = blocks[blockOf[active[t]]];
+                const float* density = block.cells[slot[DENSITY]];
+                const float* u = block.cells[slot[U]];
+                const float* v = block.cells[slot[V]];
+                for (int c = 0; c < TILE * TILE; c++) {
+                    if (density[c] > densityThreshold || std::fabs(u[c]) + std::fabs(v[c]) > velocityThreshold) {
+                        wet[t] = 1;
+                        break;
+                    }
+                }
+            }
+        });
+
+        std::fill(keep.begin(), keep.end(), 0);
+        for (size_t t = 0; t < active.size(); t++) {
+            if (!wet[t]) {
+                continue;
+            }
+            int tx = active[t] % tilesX;
+            int ty = active[t] / tilesX;
+            for (int y = std::max(0, ty - dilation); y <= std::min(tilesX - 1, ty + dilation); y++) {
+                for (int x = std::max(0, tx - dilation); x <= std::min(tilesX - 1, tx + dilation); x++) {
+                    keep[x + y * tilesX] = 1;
+                }
+            }
+        }
+
+        active.clear();
+        for (int tile = 0; tile < int(keep.size()); tile++) {
+            if (keep[tile]) {
+                if (blockOf[tile] < 0) {
+                    allocate(tile);
+                }
+                active.push_back(tile);
+            }
+            else if (blockOf[tile] >= 0) {
+                freeBlocks.push_back(blockOf[tile]);
+                blockOf[tile] = -1;
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,265 @@
+#ifndef SPH_FLUID_SIMULATION_H
+#define SPH_FLUID_SIMULATION_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "JobSystem.h"
+#include "ParticleCellList.h"
+#include "ParticleFluid.h"
+#include "RenderSnapshot.h"
+
+// Weakly compressible SPH for free-surface liquid, in window pixels. Particles are kept
+// as one array per attribute and re-sorted into cell order every substep, so the
+// neighbors of a particle are three contiguous ranges (ParticleCellList) and the kernel
+// loops stream through them eight at a time. A range holds only a dozen particles or
+// so, so with AVX2 the last partial block is a masked load rather than a scalar tail.
+//
+// Density uses the 2D poly6 kernel, pressure forces the spiky gradient with the
+// symmetric p/rho^2 form, viscosity the laminar kernel Laplacian. Pressure follows a
+// linear equation of state p = c^2 (rho - rho0), clamped at zero so the free surface
+// does not pull particles together. Each update() is split into substeps that respect
+// the acoustic CFL limit and the explicit viscosity limit.
+//
+// The acoustic limit sets the substep count, so soundSpeed is kept at about twice the
+// fastest flow, not the usual ten times: a 5 m dam break then takes about 14 substeps
+// per 10 ms update and the liquid is compressed by 2-5% on average.
+class SphFluidSimulation {
+public:
+    float restDensity = 1.0f;
+    float soundSpeed = 2000.0f; // pixels per second; the substep size follows from it
+    float viscosity = 50.0f;    // kinematic, pixels^2 per second
+    float gravity = 980.0f;     // pixels per second^2
+    float courant = 0.4f;
+    float wallRestitution = 0.2f;
+    int maxSubsteps = 40;
+
+    // spacing is the initial particle distance; the smoothing radius is twice that.
+    SphFluidSimulation(float width, float height, float spacing)
+        : spacing(spacing), kernels(2.0f * spacing), h(kernels.h), h2(kernels.h2),
+        poly6(kernels.poly6), spiky(kernels.spiky), laplacian(kernels.laplacian) {
+        mass = kernels.latticeMass(spacing, restDensity);
+        bounds.width = width;
+        bounds.height = height;
+        bounds.margin = 0.5f * spacing;
+    }
+
+    // Fills a rectangle with particles on the spacing lattice, at rest.
+    void addBlock(float x0, float y0, float x1, float y1) {
+        for (float py = y0 + 0.5f * spacing; py < y1; py += spacing) {
+            for (float px = x0 + 0.5f * spacing; px < x1; px += spacing) {
+                if (!bounds.insideObstacle(px, py)) {
+                    x.push_back(px);
+                    y.push_back(py);
+                }
+            }
+        }
+        vx.resize(x.size(), 0.0f);
+        vy.resize(x.size(), 0.0f);
+    }
+
+    void addObstacle(float centerX, float centerY, float radius) {
+        bounds.obstacles.push_back(ParticleBounds::Obstacle{ centerX, centerY, radius });
+    }
+
+    void update(float timestep) {
+        if (x.empty()) {
+            return;
+        }
+        float maxSpeed = fastestParticle();
+        float limit = std::min(courant * h / (soundSpeed + maxSpeed), 0.125f * h2 / std::max(viscosity, 1e-6f));
+        int substeps = std::min(maxSubsteps, std::max(1, int(std::ceil(timestep / limit))));
+        float dt = timestep / substeps;
+        for (int s = 0; s < substeps; s++) {
+            substep(dt);
+        }
+        lastSubsteps = substeps;
+    }
+
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        snapshot.particleX.assign(x.begin(), x.end());
+        snapshot.particleY.assign(y.begin(), y.end());
+        snapshot.particleValue.resize(x.size());
+        JobSystem::instance().parallelFor(0, x.size(), PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                snapshot.particleValue[k] = std::sqrt(vx[k] * vx[k] + vy[k] * vy[k]);
+            }
+        });
+    }
+
+    size_t getParticleCount() const {
+        return x.size();
+    }
+
+    int getSubsteps() const {
+        return lastSubsteps;
+    }
+
+private:
+    static const size_t PARTICLE_GRAIN = 512;
+
+    float spacing;
+    ParticleKernels kernels;
+    const float h, h2;
+    const float poly6, spiky, laplacian;
+    float mass = 1.0f;
+    int lastSubsteps = 0;
+
+    std::vector<float> x, y, vx, vy;
+    std::vector<float> density, pressureTerm, inverseDensity, ax, ay;
+    std::vector<float> blockSpeed;
+    ParticleBounds bounds;
+    ParticleCellList cells;
+
+    // Largest particle speed; each block of PARTICLE_GRAIN particles writes its own maximum.
+    float fastestParticle() {
+        size_t count = x.size();
+        blockSpeed.assign((count + PARTICLE_GRAIN - 1) / PARTICLE_GRAIN, 0.0f);
+        JobSystem::instance().parallelFor(0, blockSpeed.size(), 1, [&](size_t blockBegin, size_t blockEnd) {
+            for (size_t b = blockBegin; b < blockEnd; b++) {
+                float fastest = 0.0f;
+                size_t end = std::min(count, (b + 1) * PARTICLE_GRAIN);
+                for (size_t k = b * PARTICLE_GRAIN; k < end; k++) {
+                    fastest = std::max(fastest, vx[k] * vx[k] + vy[k] * vy[k]);
+                }
+                blockSpeed[b] = fastest;
+            }
+        });
+        return std::sqrt(*std::max_element(blockSpeed.begin(), blockSpeed.end()));
+    }
+
+    void substep(float dt) {
+        cells.build(x.data(), y.data(), x.size(), h, bounds.width, bounds.height);
+        cells.reorder(x);
+        cells.reorder(y);
+        cells.reorder(vx);
+        cells.reorder(vy);
+
+        size_t count = x.size();
+        density.resize(count);
+        pressureTerm.resize(count);
+        inverseDensity.resize(count);
+        ax.resize(count);
+        ay.resize(count);
+
+        float stiffness = soundSpeed * soundSpeed;
+        JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                float sum = 0.0f;
+                cells.forNeighborRanges(x[i], y[i], [&](uint32_t first, uint32_t last) {
+                    sum += densityRange(x[i], y[i], first, last);
+                });
+                float rho = mass * poly6 * sum;
+                float pressure = std::max(0.0f, stiffness * (rho - restDensity));
+                density[i] = rho;
+                inverseDensity[i] = 1.0f / rho;
+                pressureTerm[i] = pressure / (rho * rho);
+            }
+        });
+
+        JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                float fx = 0.0f;
+                float fy = 0.0f;
+                cells.forNeighborRanges(x[i], y[i], [&](uint32_t first, uint32_t last) {
+                    forceRange(i, first, last, fx, fy);
+                });
+                ax[i] = fx;
+                ay[i] = fy + gravity;
+            }
+        });
+
+        JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                vx[i] += dt * ax[i];
+                vy[i] += dt * ay[i];
+                x[i] += dt * vx[i];
+                y[i] += dt * vy[i];
+                bounds.collide(x[i], y[i], vx[i], vy[i], wallRestitution);
+            }
+        });
+    }
+
+    // Sum of (h^2 - r^2)^3 over one contiguous neighbor range.
+    float densityRange(float xi, float yi, uint32_t first, uint32_t last) const {
+        float sum = 0.0f;
+        uint32_t j = first;
+#ifdef PARTICLE_FLUID_AVX2
+        __m256 vxi = _mm256_set1_ps(xi);
+        __m256 vyi = _mm256_set1_ps(yi);
+        __m256 vh2 = _mm256_set1_ps(h2);
+        __m256 zero = _mm256_setzero_ps();
+        __m256 acc = zero;
+        for (; j < last; j += 8) {
+            __m256i lanes = particleTailMask(last - j);
+            __m256 dx = _mm256_sub_ps(vxi, _mm256_maskload_ps(&x[j], lanes));
+            __m256 dy = _mm256_sub_ps(vyi, _mm256_maskload_ps(&y[j], lanes));
+            __m256 r2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            __m256 d = _mm256_and_ps(_mm256_max_ps(_mm256_sub_ps(vh2, r2), zero), _mm256_castsi256_ps(lanes));
+            acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_mul_ps(d, d), d));
+        }
+        sum = particleHorizontalSum(acc);
+#endif
+        for (; j < last; j++) {
+            float dx = xi - x[j];
+            float dy = yi - y[j];
+            float d = std::max(h2 - (dx * dx + dy * dy), 0.0f);
+            sum += d * d * d;
+        }
+        return sum;
+    }
+
+    // Pressure and viscosity acceleration on particle i from one neighbor range.
+    void forceRange(size_t i, uint32_t first, uint32_t last, float& fx, float& fy) const {
+        float xi = x[i], yi = y[i], vxi = vx[i], vyi = vy[i];
+        float pi = pressureTerm[i];
+        float pressureScale = mass * spiky;
+        float viscosityScale = mass * laplacian * viscosity * inverseDensity[i];
+        uint32_t j = first;
+#ifdef PARTICLE_FLUID_AVX2
+        __m256 accX = _mm256_setzero_ps();
+        __m256 accY = _mm256_setzero_ps();
+        __m256 vh = _mm256_set1_ps(h);
+        __m256 vh2 = _mm256_set1_ps(h2);
+        __m256 tiny = _mm256_set1_ps(1e-12f);
+        for (; j < last; j += 8) {
+            __m256i lanes = particleTailMask(last - j);
+            __m256 dx = _mm256_sub_ps(_mm256_set1_ps(xi), _mm256_maskload_ps(&x[j], lanes));
+            __m256 dy = _mm256_sub_ps(_mm256_set1_ps(yi), _mm256_maskload_ps(&y[j], lanes));
+            __m256 r2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+            __m256 valid = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(r2, vh2, _CMP_LT_OQ), _mm256_cmp_ps(r2, tiny, _CMP_GT_OQ)),
+                _mm256_castsi256_ps(lanes));
+            if (_mm256_movemask_ps(valid) == 0) {
+                continue;
+            }
+            __m256 r = _mm256_sqrt_ps(_mm256_max_ps(r2, tiny));
+            __m256 w = _mm256_sub_ps(vh, r);
+            __m256 pressure = _mm256_div_ps(
+                _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(pressureScale), _mm256_add_ps(_mm256_set1_ps(pi), _mm256_maskload_ps(&pressureTerm[j], lanes))), _mm256_mul_ps(w, w)), r);
+            __m256 visc = _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(viscosityScale), _mm256_maskload_ps(&inverseDensity[j], lanes)), w);
+            __m256 gx = _mm256_add_ps(_mm256_mul_ps(pressure, dx), _mm256_mul_ps(visc, _mm256_sub_ps(_mm256_maskload_ps(&vx[j], lanes), _mm256_set1_ps(vxi))));
+            __m256 gy = _mm256_add_ps(_mm256_mul_ps(pressure, dy), _mm256_mul_ps(visc, _mm256_sub_ps(_mm256_maskload_ps(&vy[j], lanes), _mm256_set1_ps(vyi))));
+            accX = _mm256_add_ps(accX, _mm256_and_ps(valid, gx));
+            accY = _mm256_add_ps(accY, _mm256_and_ps(valid, gy));
+        }
+        fx += particleHorizontalSum(accX);
+        fy += particleHorizontalSum(accY);
+#endif
+        for (; j < last; j++) {
+            float dx = xi - x[j];
+            float dy = yi - y[j];
+            float r2 = dx * dx + dy * dy;
+            if (r2 >= h2 || r2 <= 1e-12f) {
+                continue;
+            }
+            float r = std::sqrt(r2);
+            float w = h - r;
+            float pressure = pressureScale * (pi + pressureTerm[j]) * w * w / r;
+            float visc = viscosityScale * inverseDensity[j] * w;
+            fx += pressure * dx + visc * (vx[j] - vxi);
+            fy += pressure * dy + visc * (vy[j] - vyi);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <SFML/Graphics.hpp>
+#include <vector>
+#include <algorithm>
+#include <limits>
+
+// Fixed-capacity history. Pushing past capacity overwrites the oldest entry.
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity = 0)
+        : data(capacity), head(0), count(0) {
+    }
+
+    void push(const T& value) {
+        if (data.empty()) {
+            return;
+        }
+        data[head] = value;
+        head = (head + 1) % data.size();
+        count = std::min(count + 1, data.size());
+    }
+
+    // 0 is the oldest element.
+    const T& operator[](size_t index) const {
+        return data[(head + data.size() - count + index) % data.size()];
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t capacity() const {
+        return data.size();
+    }
+
+    void clear() {
+        head = 0;
+        count = 0;
+    }
+
+private:
+    std::vector<T> data;
+    size_t head;
+    size_t count;
+};
+
+struct TelemetrySample {
+    float mean = 0.0f;
+    float max = 0.0f;
+};
+
+// Collects any number of values during one step and reduces them to one sample.
+class TelemetrySeries {
+public:
+    void add(float value) {
+        sum += value;
+        peak = std::max(peak, value);
+        ++count;
+    }
+
+    TelemetrySample commit() {
+        TelemetrySample sample;
+        if (count > 0) {
+            sample.mean = static_cast<float>(sum / count);
+            sample.max = peak;
+        }
+        sum = 0.0;
+        peak = -std::numeric_limits<float>::max();
+        count = 0;
+        return sample;
+    }
+
+private:
+    double sum = 0.0;
+    float peak = -std::numeric_limits<float>::max();
+    size_t count = 0;
+};
+
+// Loaded on first use and shared by every overlay; its glyph texture is built once.
+inline const sf::Font& telemetryFont() {
+    static sf::Font font;
+    static bool loaded = font.loadFromFile("arial.ttf");
+    (void)loaded;
+    return font;
+}
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef TRACER_PARTICLES_H
+#define TRACER_PARTICLES_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include "JobSystem.h"
+#include "ParticleCellList.h"
+#include "RenderSnapshot.h"
+#include "FluidSimulation.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TRACER_PARTICLES_AVX2 1
+#endif
+
+// Massless tracers carried by a FluidSimulation's velocity, for visualizing and measuring
+// mixing. Positions are in grid coordinates (cell i is centered on x = i), one array per
+// attribute, and every update() moves them with one midpoint (RK2) step through bilinear
+// velocity lookups, split over the JobSystem and, with AVX2, eight tracers at a time.
+//
+// The lookups gather from wherever the tracers are, so every sortInterval updates the
+// arrays are re-sorted by cell (ParticleCellList): neighbors in memory then read the same
+// few cache lines of u and v. Tracers do not see obstacles beyond the zero velocity inside
+// them, and are clamped to the same interior the advection backtrace uses.
+class TracerParticles {
+public:
+    int sortInterval = 16;
+
+    // count tracers spread uniformly over the fluid cells.
+    void seed(const FluidSimulation& sim, size_t count) {
+        N = sim.getSize();
+        x.resize(count);
+        y.resize(count);
+        speed.assign(count, 0.0f);
+
+        uint32_t hash = 12345;
+        float span = N - 2.0f;
+        for (size_t k = 0; k < count; k++) {
+            do {
+                hash = hash * 1664525u + 1013904223u;
+                x[k] = 0.5f + span * (float(hash >> 8) / 16777216.0f);
+                hash = hash * 1664525u + 1013904223u;
+                y[k] = 0.5f + span * (float(hash >> 8) / 16777216.0f);
+            } while (sim.isSolid(int(x[k] + 0.5f), int(y[k] + 0.5f)));
+        }
+        sortByCell();
+        stepsSinceSort = 0;
+    }
+
+    void update(const FluidSimulation& sim, float dt) {
+        if (x.empty()) {
+            return;
+        }
+        const float* u = sim.getU().data();
+        const float* v = sim.getV().data();
+        JobSystem::instance().parallelFor(0, x.size(), PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            advectRange(u, v, dt, begin, end);
+        });
+
+        if (++stepsSinceSort >= sortInterval) {
+            sortByCell();
+            stepsSinceSort = 0;
+        }
+    }
+
+    // Particles in window pixels, valued by speed in pixels per second.
+    void writeSnapshot(RenderSnapshot& snapshot, float cellSize) const {
+        size_t count = x.size();
+        snapshot.particleX.resize(count);
+        snapshot.particleY.resize(count);
+        snapshot.particleValue.resize(count);
+        JobSystem::instance().parallelFor(0, count, PARTICLE_GRAIN, [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                snapshot.particleX[k] = (x[k] + 0.5f) * cellSize;
+                snapshot.particleY[k] = (y[k] + 0.5f) * cellSize;
+                snapshot.particleValue[k] = speed[k] * cellSize;
+            }
+        });
+    }
+
+    size_t getCount() const {
+        return x.size();
+    }
+
+    const std::vector<float>& getX() const {
+        return x;
+    }
+
+    const std::vector<float>& getY() const {
+        return y;
+    }
+
+private:
+    static const size_t PARTICLE_GRAIN = 16384;
+
+    int N = 0;
+    int stepsSinceSort = 0;
+    std::vector<float> x, y, speed;
+    ParticleCellList cells;
+
+    void sortByCell() {
+        cells.build(x.data(), y.data(), x.size(), 1.0f, float(N), float(N));
+        cells.reorder(x);
+        cells.reorder(y);
+        cells.reorder(speed);
+    }
+
+    void sample(const float* u, const float* v, float px, float py, float& su, float& sv) const {
+        px = std::max(0.5f, std::min(px, N - 1.5f));
+        py = std::max(0.5f, std::min(py, N - 1.5f));
+        int i0 = int(px);
+        int j0 = int(py);
+        float s1 = px - i0;
+        float t1 = py - j0;
+        int c = i0 + j0 * N;
+        su = lerp2(u, c, s1, t1);
+        sv = lerp2(v, c, s1, t1);
+    }
+
+    // Same operation order as the AVX2 lerp2, so a tracer moves the same in either path.
+    float lerp2(const float* field, int c, float s1, float t1) const {
+        float low = field[c] + s1 * (field[c + 1] - field[c]);
+        float high = field[c + N] + s1 * (field[c + N + 1] - field[c + N]);
+        return low + t1 * (high - low);
+    }
+
+    void advectRange(const float* u, const float* v, float dt, size_t begin, size_t end) {
+        size_t k = begin;
+#ifdef TRACER_PARTICLES_AVX2
+        const __m256 lo = _mm256_set1_ps(0.5f);
+        const __m256 hi = _mm256_set1_ps(N - 1.5f);
+        const __m256 vdt = _mm256_set1_ps(dt);
+        const __m256 half = _mm256_set1_ps(0.5f * dt);
+        const __m256i stride = _mm256_set1_epi32(N);
+
+        // Bilinear u and v at eight points, clamped to the interior first.
+        auto sample8 = [&](__m256 px, __m256 py, __m256& su, __m256& sv) {
+            px = _mm256_min_ps(_mm256_max_ps(px, lo), hi);
+            py = _mm256_min_ps(_mm256_max_ps(py, lo), hi);
+            __m256i i0 = _mm256_cvttps_epi32(px);
+            __m256i j0 = _mm256_cvttps_epi32(py);
+            __m256 s1 = _mm256_sub_ps(px, _mm256_cvtepi32_ps(i0));
+            __m256 t1 = _mm256_sub_ps(py, _mm256_cvtepi32_ps(j0));
+            __m256i index = _mm256_add_epi32(i0, _mm256_mullo_epi32(j0, stride));
+            __m256i indexUp = _mm256_add_epi32(index, stride);
+
+            auto lerp2 = [&](const float* field) {
+                __m256 a = _mm256_i32gather_ps(field, index, 4);
+                __m256 b = _mm256_i32gather_ps(field + 1, index, 4);
+                __m256 c = _mm256_i32gather_ps(field, indexUp, 4);
+                __m256 d = _mm256_i32gather_ps(field + 1, indexUp, 4);
+                __m256 low = _mm256_add_ps(a, _mm256_mul_ps(s1, _mm256_sub_ps(b, a)));
+                __m256 high = _mm256_add_ps(c, _mm256_mul_ps(s1, _mm256_sub_ps(d, c)));
+                return _mm256_add_ps(low, _mm256_mul_ps(t1, _mm256_sub_ps(high, low)));
+            };
+            su = lerp2(u);
+            sv = lerp2(v);
+        };
+
+        for (; k + 8 <= end; k += 8) {
+            __m256 px = _mm256_loadu_ps(&x[k]);
+            __m256 py = _mm256_loadu_ps(&y[k]);
+            __m256 u1, v1, u2, v2;
+            sample8(px, py, u1, v1);
+            sample8(_mm256_add_ps(px, _mm256_mul_ps(half, u1)), _mm256_add_ps(py, _mm256_mul_ps(half, v1)), u2, v2);
+
+            px = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(px, _mm256_mul_ps(vdt, u2)), lo), hi);
+            py = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(py, _mm256_mul_ps(vdt, v2)), lo), hi);
+            _mm256_storeu_ps(&x[k], px);
+            _mm256_storeu_ps(&y[k], py);
+            _mm256_storeu_ps(&speed[k], _mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(u2, u2), _mm256_mul_ps(v2, v2))));
+        }
+#endif
+        for (; k < end; k++) {
+            float u1, v1, u2, v2;
+            sample(u, v, x[k], y[k], u1, v1);
+            sample(u, v, x[k] + 0.5f * dt * u1, y[k] + 0.5f * dt * v1, u2, v2);
+            x[k] = std::max(0.5f, std::min(x[k] + dt * u2, N - 1.5f));
+            y[k] = std::max(0.5f, std::min(y[k] + dt * v2, N - 1.5f));
+            speed[k] = std::sqrt(u2 * u2 + v2 * v2);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+
+// Single-producer, single-consumer hand-off without locks. The writer fills its own
+// buffer and swaps it with the shared middle slot; the reader swaps the middle slot
+// with its own only when something newer was published. Neither side ever waits,
+// and the reader always sees the most recent complete buffer.
+template <typename T>
+class TripleBuffer {
+public:
+    T& writeBuffer() {
+        return buffers[writeIndex];
+    }
+
+    void publish() {
+        unsigned int previous = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX_MASK;
+    }
+
+    // Returns true if a newer buffer became readable.
+    bool update() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) {
+            return false;
+        }
+        unsigned int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const {
+        return buffers[readIndex];
+    }
+
+private:
+    static const unsigned int FRESH = 4;
+    static const unsigned int INDEX_MASK = 3;
+
+    T buffers[3];
+    std::atomic<unsigned int> middle{ 1 };
+    unsigned int writeIndex = 0;
+    unsigned int readIndex = 2;
+};
+
+#endif
@@ -0,0 +1,369 @@
+#ifndef WAVELET_TURBULENCE_H
+#define WAVELET_TURBULENCE_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <algorithm>
+#include <SFML/System/Clock.hpp>
+#include "JobSystem.h"
+#include "AdvectionKernel.h"
+#include "FluidSimulation.h"
+#include "RenderSnapshot.h"
+
+// Wavelet turbulence (Kim et al. 2008) on top of a FluidSimulation: a density field
+// upsampling times finer than the simulation, advected by the coarse velocity plus
+// synthesized small-scale motion. The projection never runs at the fine resolution.
+//
+// The detail is the curl of band-limited wavelet noise (Cook and DeRose 2005), so it is
+// divergence free, summed over one octave per factor of two between the coarse and the
+// fine grid with the Kolmogorov falloff 2^(-5/6) per octave. Its strength follows the
+// coarse kinetic energy the grid can barely resolve: the energy minus its 3x3 average.
+// The noise is looked up through texture coordinates advected with the coarse flow, so
+// the detail moves with the fluid. Two sets are kept half a period apart, each reset
+// when it is the one faded out, which hides the distortion advection builds up.
+class WaveletTurbulence {
+public:
+    float strength = 2.0f;
+    int regenerationSteps = 60; // texture coordinate lifetime, in steps
+
+    WaveletTurbulence(int coarseSize, int upsampling)
+        : N(coarseSize), upres(upsampling), M(coarseSize * upsampling),
+        energy(N * N, 0.0f), amplitude(N * N, 0.0f), fineU(M * M, 0.0f), fineV(M * M, 0.0f),
+        density(M * M, 0.0f), densityPrev(M * M, 0.0f), fineSolid(M * M, 0) {
+        octaves = 0;
+        while ((1 << octaves) < upres) {
+            octaves++;
+        }
+        for (int set = 0; set < 2; set++) {
+            for (int axis = 0; axis < 2; axis++) {
+                coordinates[set][axis].resize(N * N);
+                coordinatesPrev[set][axis].resize(N * N);
+            }
+            resetCoordinates(set);
+        }
+        generateNoise();
+    }
+
+    // Starts the fine density over from the simulation's, bilinearly upsampled.
+    void seed(const FluidSimulation& simulation) {
+        const std::vector<float>& coarse = simulation.getDensity();
+        JobSystem::instance().parallelFor(0, M, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 0; i < M; i++) {
+                    density[i + j * M] = sampleCoarse(coarse, toCoarse(i), toCoarse(j));
+                    fineSolid[i + j * M] = simulation.isSolid(i / upres, j / upres) ? 1 : 0;
+                }
+            }
+        });
+        seeded = true;
+    }
+
+    // Call after simulation.update(timestep).
+    void update(const FluidSimulation& simulation, float timestep) {
+        sf::Clock clock;
+        if (!seeded) {
+            seed(simulation);
+        }
+
+        const std::vector<float>& u = simulation.getU();
+        const std::vector<float>& v = simulation.getV();
+        advectCoordinates(u, v, timestep);
+        computeAmplitude(simulation, u, v);
+        synthesizeVelocity(u, v);
+
+        std::swap(density, densityPrev);
+        float* destination[] = { density.data() };
+        const float* source[] = { densityPrev.data() };
+        advector.advect(1, destination, source, fineU.data(), fineV.data(), timestep, M);
+        copyEdges(density, M);
+        for (int c = 0; c < M * M; c++) {
+            if (fineSolid[c]) {
+                density[c] = 0.0f;
+            }
+        }
+
+        series[FluidSimulation::StepTime].add(clock.getElapsedTime().asSeconds());
+        for (int channel = 0; channel < FluidSimulation::ChannelCount; ++channel) {
+            stepTelemetry[channel] = series[channel].commit();
+        }
+    }
+
+    // The fine density and velocity; telemetry is the upsampling cost alone.
+    void writeSnapshot(RenderSnapshot& snapshot) const {
+        snapshot.fluidSize = M;
+        snapshot.density.assign(density.begin(), density.end());
+        snapshot.u.resize(M * M);
+        snapshot.v.resize(M * M);
+        float toCoarseUnits = 1.0f / upres;
+        for (int c = 0; c < M * M; c++) {
+            snapshot.u[c] = fineU[c] * toCoarseUnits;
+            snapshot.v[c] = fineV[c] * toCoarseUnits;
+        }
+        snapshot.solid.assign(fineSolid.begin(), fineSolid.end());
+        snapshot.telemetry.assign(stepTelemetry, stepTelemetry + FluidSimulation::ChannelCount);
+    }
+
+    int getFineSize() const {
+        return M;
+    }
+
+private:
+    static const int ROW_GRAIN = 16;
+    static const int TILE = 128;
+
+    int N, upres, M;
+    int octaves;
+    int step = 0;
+    bool seeded = false;
+    float gradientScale = 1.0f; // reciprocal RMS of the noise gradient
+
+    std::vector<float> noise; // TILE x TILE, periodic
+    std::vector<float> energy, amplitude;
+    std::vector<float> coordinates[2][2], coordinatesPrev[2][2];
+    std::vector<float> fineU, fineV, density, densityPrev;
+    std::vector<uint8_t> fineSolid;
+    AdvectionKernel advector;
+    TelemetrySeries series[FluidSimulation::ChannelCount];
+    TelemetrySample stepTelemetry[FluidSimulation::ChannelCount];
+
+    // Center of fine cell i in coarse cell coordinates.
+    float toCoarse(int i) const {
+        return (i + 0.5f) / upres - 0.5f;
+    }
+
+    float sampleCoarse(const std::vector<float>& field, float x, float y) const {
+        x = std::min(std::max(x, 0.0f), N - 1.001f);
+        y = std::min(std::max(y, 0.0f), N - 1.001f);
+        int i0 = int(x);
+        int j0 = int(y);
+        float s = x - i0;
+        float t = y - j0;
+        const float* f = &field[i0 + j0 * N];
+        return (1.0f - t) * ((1.0f - s) * f[0] + s * f[1]) + t * ((1.0f - s) * f[N] + s * f[N + 1]);
+    }
+
+    static void copyEdges(std::vector<float>& x, int n) {
+        for (int i = 1; i < n - 1; i++) {
+            x[i] = x[i + n];
+            x[i + (n - 1) * n] = x[i + (n - 2) * n];
+            x[i * n] = x[i * n + 1];
+            x[i * n + n - 1] = x[i * n + n - 2];
+        }
+        x[0] = x[n + 1];
+        x[n - 1] = x[2 * n - 2];
+        x[(n - 1) * n] = x[(n - 2) * n + 1];
+        x[n * n - 1] = x[(n - 1) * n - 2];
+    }
+
+    void resetCoordinates(int set) {
+        for (int j = 0; j < N; j++) {
+            for (int i = 0; i < N; i++) {
+                coordinates[set][0][i + j * N] = float(i);
+                coordinates[set][1][i + j * N] = float(j);
+            }
+        }
+    }
+
+    // Weight of set 0; set 1 gets the rest. Each set is reset where its weight is zero.
+    float blendWeight() const {
+        float phase = float(step % regenerationSteps) / regenerationSteps;
+        return 1.0f - std::abs(2.0f * phase - 1.0f);
+    }
+
+    void advectCoordinates(const std::vector<float>& u, const std::vector<float>& v, float timestep) {
+        step++;
+        if (step % regenerationSteps == 0) {
+            resetCoordinates(0);
+        }
+        if ((step + regenerationSteps / 2) % regenerationSteps == 0) {
+            resetCoordinates(1);
+        }
+        float* destination[4];
+        const float* source[4];
+        for (int set = 0; set < 2; set++) {
+            for (int axis = 0; axis < 2; axis++) {
+                std::swap(coordinates[set][axis], coordinatesPrev[set][axis]);
+                destination[set * 2 + axis] = coordinates[set][axis].data();
+                source[set * 2 + axis] = coordinatesPrev[set][axis].data();
+            }
+        }
+        advector.advect(4, destination, source, u.data(), v.data(), timestep, N);
+        for (int set = 0; set < 2; set++) {
+            for (int axis = 0; axis < 2; axis++) {
+                copyEdges(coordinates[set][axis], N);
+            }
+        }
+    }
+
+    // sqrt(2 e) of the kinetic energy above the 3x3 average, in coarse cells per second.
+    void computeAmplitude(const FluidSimulation& simulation, const std::vector<float>& u, const std::vector<float>& v) {
+        for (int c = 0; c < N * N; c++) {
+            energy[c] = simulation.isSolid(c % N, c / N) ? 0.0f : 0.5f * (u[c] * u[c] + v[c] * v[c]);
+        }
+        JobSystem::instance().parallelFor(0, N, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                for (int i = 0; i < N; i++) {
+                    float sum = 0.0f;
+                    int count = 0;
+                    for (int b = std::max(j - 1, 0); b <= std::min(j + 1, N - 1); b++) {
+                        for (int a = std::max(i - 1, 0); a <= std::min(i + 1, N - 1); a++) {
+                            sum += energy[a + b * N];
+                            count++;
+                        }
+                    }
+                    float band = std::abs(energy[i + j * N] - sum / count);
+                    amplitude[i + j * N] = strength * std::sqrt(2.0f * band);
+                }
+            }
+        });
+    }
+
+    // Coarse velocity plus the noise curl, both converted to fine cells per second.
+    void synthesizeVelocity(const std::vector<float>& u, const std::vector<float>& v) {
+        float weight0 = blendWeight();
+        float weight1 = 1.0f - weight0;
+        float variance = 1.0f / std::sqrt(weight0 * weight0 + weight1 * weight1);
+        JobSystem::instance().parallelFor(0, M, ROW_GRAIN, [&](size_t rowBegin, size_t rowEnd) {
+            for (int j = int(rowBegin); j < int(rowEnd); j++) {
+                float y = toCoarse(j);
+                for (int i = 0; i < M; i++) {
+                    int c = i + j * M;
+                    if (fineSolid[c]) {
+                        fineU[c] = 0.0f;
+                        fineV[c] = 0.0f;
+                        continue;
+                    }
+                    float x = toCoarse(i);
+                    float turbulenceX = 0.0f;
+                    float turbulenceY = 0.0f;
+                    float a = sampleCoarse(amplitude, x, y);
+                    if (a > 0.0f) {
+                        float weights[2] = { weight0 * variance, weight1 * variance };
+                        for (int set = 0; set < 2; set++) {
+                            float tx = sampleCoarse(coordinates[set][0], x, y);
+                            float ty = sampleCoarse(coordinates[set][1], x, y);
+                            float octaveWeight = weights[set];
+                            float frequency = 2.0f;
+                            for (int octave = 0; octave < octaves; octave++) {
+                                float gradX, gradY;
+                                noiseGradient(tx * frequency, ty * frequency, gradX, gradY);
+                                turbulenceX += octaveWeight * gradY;
+                                turbulenceY -= octaveWeight * gradX;
+                                octaveWeight *= 0.56123f; // 2^(-5/6)
+                                frequency *= 2.0f;
+                            }
+                        }
+                    }
+                    float scale = a * gradientScale;
+                    fineU[c] = upres * (sampleCoarse(u, x, y) + scale * turbulenceX);
+                    fineV[c] = upres * (sampleCoarse(v, x, y) + scale * turbulenceY);
+                }
+            }
+        });
+    }
+
+    // Gradient of the quadratic B-spline interpolated noise tile at (x, y), in tile cells.
+    void noiseGradient(float x, float y, float& gradX, float& gradY) const {
+        float wx[3], dwx[3], wy[3], dwy[3];
+        int ix = splineWeights(x, wx, dwx);
+        int iy = splineWeights(y, wy, dwy);
+        gradX = 0.0f;
+        gradY = 0.0f;
+        for (int b = 0; b < 3; b++) {
+            const float* row = &noise[((iy + b) & (TILE - 1)) * TILE];
+            float value = 0.0f;
+            float slope = 0.0f;
+            for (int a = 0; a < 3; a++) {
+                float n = row[(ix + a) & (TILE - 1)];
+                value += wx[a] * n;
+                slope += dwx[a] * n;
+            }
+            gradX += wy[b] * slope;
+            gradY += dwy[b] * value;
+        }
+    }
+
+    // Weights of the three taps starting at the returned cell, and their derivatives.
+    static int splineWeights(float p, float* w, float* dw) {
+        float mid = std::ceil(p - 0.5f);
+        float t = mid - (p - 0.5f);
+        w[0] = 0.5f * t * t;
+        w[2] = 0.5f * (1.0f - t) * (1.0f - t);
+        w[1] = 1.0f - w[0] - w[2];
+        dw[0] = -t;
+        dw[2] = 1.0f - t;
+        dw[1] = 2.0f * t - 1.0f;
+        return int(mid) - 1;
+    }
+
+    // Cook and DeRose: random values minus their own downsampled-then-upsampled copy,
+    // which leaves only the top octave, plus a copy shifted by an odd offset (just over
+    // half a tile) to even out the variance between even and odd cells.
+    void generateNoise() {
+        static const float down[32] = {
+            0.000334f, -0.001528f, 0.000410f, 0.003545f, -0.000938f, -0.008233f, 0.002172f, 0.019120f,
+            -0.005040f, -0.044412f, 0.011655f, 0.103311f, -0.025936f, -0.243780f, 0.033979f, 0.655340f,
+            0.655340f, 0.033979f, -0.243780f, -0.025936f, 0.103311f, 0.011655f, -0.044412f, -0.005040f,
+            0.019120f, 0.002172f, -0.008233f, -0.000938f, 0.003546f, 0.000410f, -0.001528f, 0.000334f };
+        static const float up[4] = { 0.25f, 0.75f, 0.75f, 0.25f };
+
+        std::mt19937 random(1234);
+        std::normal_distribution<float> gaussian(0.0f, 1.0f);
+        std::vector<float> values(TILE * TILE);
+        for (float& value : values) {
+            value = gaussian(random);
+        }
+
+        // Filter every row, then every column, through down then up.
+        std::vector<float> smooth = values;
+        std::vector<float> half(TILE / 2);
+        for (int axis = 0; axis < 2; axis++) {
+            int stride = axis == 0 ? 1 : TILE;
+            int lineStride = axis == 0 ? TILE : 1;
+            for (int line = 0; line < TILE; line++) {
+                float* f = &smooth[line * lineStride];
+                for (int i = 0; i < TILE / 2; i++) {
+                    float sum = 0.0f;
+                    for (int k = 2 * i - 16; k < 2 * i + 16; k++) {
+                        sum += down[k - 2 * i + 16] * f[((k % TILE + TILE) % TILE) * stride];
+                    }
+                    half[i] = sum;
+                }
+                for (int i = 0; i < TILE; i++) {
+                    float sum = 0.0f;
+                    for (int k = i / 2; k <= i / 2 + 1; k++) {
+                        sum += up[i - 2 * k + 2] * half[k % (TILE / 2)];
+                    }
+                    f[i * stride] = sum;
+                }
+            }
+        }
+
+        noise.resize(TILE * TILE);
+        for (int c = 0; c < TILE * TILE; c++) {
+            noise[c] = values[c] - smooth[c];
+        }
+        // An even shift would line even cells up with even cells again.
+        const int offset = TILE / 2 + 1;
+        std::vector<float> shifted = noise;
+        for (int j = 0; j < TILE; j++) {
+            for (int i = 0; i < TILE; i++) {
+                noise[i + j * TILE] += shifted[((i + offset) % TILE) + ((j + offset) % TILE) * TILE];
+            }
+        }
+
+        double sum = 0.0;
+        for (int j = 0; j < TILE; j++) {
+            for (int i = 0; i < TILE; i++) {
+                float gradX, gradY;
+                noiseGradient(i + 0.25f, j + 0.75f, gradX, gradY);
+                sum += gradX * gradX + gradY * gradY;
+            }
+        }
+        gradientScale = float(1.0 / std::sqrt(sum / (TILE * TILE)));
+    }
+};
+
+#endif
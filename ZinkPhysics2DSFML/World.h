@@ -0,0 +1,310 @@
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include "RigidBody.h"
+#include "Vector2D.h"
+#include "ConstraintSolver.h"
+
+struct DistanceJoint {
+    int bodyA;
+    int bodyB;
+    float restLength;
+    float compliance; // inverse stiffness, 0 is rigid
+    float lambda = 0.0f;
+
+    DistanceJoint(int a, int b, float restLength, float compliance = 0.0f)
+        : bodyA(a), bodyB(b), restLength(restLength), compliance(compliance) {
+    }
+};
+
+class World {
+public:
+    enum class StepMode {
+        Impulse, // integrate, detect, sequential impulses
+        Substep  // XPBD: one detection pass, N position substeps
+    };
+
+    StepMode stepMode = StepMode::Impulse;
+    int substeps = 8;
+    float contactCompliance = 0.0f;
+    float restitution = 0.9f;
+    float friction = 0.5f;
+    float maxVelocity = 25.0f;
+    Vector2D gravity;
+    ConstraintSolver solver;
+
+    World(const Vector2D& gravity = Vector2D(0, 0), float width = 800.0f, float height = 600.0f)
+        : gravity(gravity), width(width), height(height) {
+    }
+
+    int addBody(const RigidBody& body) {
+        bodies.push_back(body);
+        return static_cast<int>(bodies.size()) - 1;
+    }
+
+    void addJoint(const DistanceJoint& joint) {
+        joints.push_back(joint);
+    }
+
+    void setBounds(float newWidth, float newHeight) {
+        width = newWidth;
+        height = newHeight;
+    }
+
+    std::vector<RigidBody>& getBodies() {
+        return bodies;
+    }
+
+    const std::vector<RigidBody>& getBodies() const {
+        return bodies;
+    }
+
+    void step(float dt) {
+        if (stepMode == StepMode::Substep) {
+            stepSubstepped(dt);
+        }
+        else {
+            stepImpulse(dt);
+        }
+        clampVelocities();
+    }
+
+private:
+    std::vector<RigidBody> bodies;
+    std::vector<DistanceJoint> joints;
+    std::vector<ContactConstraint> contacts;
+    std::vector<Vector2D> previousPositions;
+    std::vector<Vector2D> preSolveVelocities;
+    std::vector<float> previousAngles;
+    float width, height;
+
+    void stepImpulse(float dt) {
+        for (auto& body : bodies) {
+            body.applyGravity(gravity);
+            body.update(dt);
+            reflectBounds(body);
+        }
+
+        contacts.clear();
+        buildContacts(bodies, contacts);
+        solver.solve(bodies, contacts, dt);
+
+        // Joints have no velocity formulation here; project them once, XPBD style.
+        if (!joints.empty()) {
+            storePrevious();
+            for (auto& joint : joints) {
+                joint.lambda = 0.0f;
+                solveJoint(joint, dt);
+            }
+            for (size_t i = 0; i < bodies.size(); ++i) {
+                bodies[i].velocity += (bodies[i].position - previousPositions[i]) / dt;
+            }
+        }
+    }
+
+    // Contacts that may touch within this step, found once and re-evaluated per substep.
+    void collectContacts(float dt) {
+        contacts.clear();
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            const RigidBody& a = bodies[i];
+            float marginA = a.velocity.length() * dt;
+            for (size_t j = i + 1; j < bodies.size(); ++j) {
+                const RigidBody& b = bodies[j];
+                float reach = a.radius + b.radius + marginA + b.velocity.length() * dt;
+                if ((b.position - a.position).lengthSquared() < reach * reach) {
+                    contacts.emplace_back(static_cast<int>(i), static_cast<int>(j), Vector2D(0, 0), 0.0f, restitution, friction);
+                }
+            }
+
+            float margin = a.radius + marginA;
+            if (a.position.x < margin) contacts.emplace_back(static_cast<int>(i), -1, Vector2D(-1, 0), 0.0f, restitution, friction);
+            if (a.position.x > width - margin) contacts.emplace_back(static_cast<int>(i), -1, Vector2D(1, 0), 0.0f, restitution, friction);
+            if (a.position.y < margin) contacts.emplace_back(static_cast<int>(i), -1, Vector2D(0, -1), 0.0f, restitution, friction);
+            if (a.position.y > height - margin) contacts.emplace_back(static_cast<int>(i), -1, Vector2D(0, 1), 0.0f, restitution, friction);
+        }
+    }
+
+    void stepSubstepped(float dt) {
+        collectContacts(dt);
+
+        float h = dt / substeps;
+        for (int s = 0; s < substeps; ++s) {
+            storePrevious();
+            for (auto& body : bodies) {
+                if (body.invMass == 0.0f) continue;
+                body.velocity += (gravity + body.acceleration) * h;
+                body.position += body.velocity * h;
+                body.angle += body.angularVelocity * h;
+            }
+
+            for (auto& joint : joints) {
+                joint.lambda = 0.0f;
+                solveJoint(joint, h);
+            }
+            for (auto& contact : contacts) {
+                contact.normalImpulse = 0.0f;
+                solveContactPosition(contact, h);
+            }
+
+            for (size_t i = 0; i < bodies.size(); ++i) {
+                preSolveVelocities[i] = bodies[i].velocity;
+                bodies[i].velocity = (bodies[i].position - previousPositions[i]) / h;
+                bodies[i].angularVelocity = (bodies[i].angle - previousAngles[i]) / h;
+            }
+
+            for (auto& contact : contacts) {
+                solveContactVelocity(contact, h);
+            }
+        }
+
+        for (auto& body : bodies) {
+            body.acceleration = Vector2D(0, 0);
+        }
+    }
+
+    void storePrevious() {
+        previousPositions.resize(bodies.size());
+        previousAngles.resize(bodies.size());
+        preSolveVelocities.resize(bodies.size());
+        for (size_t i = 0; i < bodies.size(); ++i) {
+            previousPositions[i] = bodies[i].position;
+            previousAngles[i] = bodies[i].angle;
+        }
+    }
+
+    // Returns the current separation along the contact normal; negative means overlap.
+    float evaluateContact(ContactConstraint& contact) {
+        RigidBody& a = bodies[contact.bodyA];
+        if (contact.bodyB >= 0) {
+            RigidBody& b = bodies[contact.bodyB];
+            Vector2D diff = b.position - a.position;
+            float distance = diff.length();
+            contact.normal = distance > 0.0f ? diff / distance : Vector2D(0, 1);
+            return distance - (a.radius + b.radius);
+        }
+
+        if (contact.normal.x < 0) return a.position.x - a.radius;
+        if (contact.normal.x > 0) return width - (a.position.x + a.radius);
+        if (contact.normal.y < 0) return a.position.y - a.radius;
+        return height - (a.position.y + a.radius);
+    }
+
+    void solveContactPosition(ContactConstraint& contact, float h) {
+        float separation = evaluateContact(contact);
+        contact.penetration = -separation;
+        if (separation >= 0.0f) return;
+
+        RigidBody& a = bodies[contact.bodyA];
+        float wA = a.invMass;
+        float wB = contact.bodyB >= 0 ? bodies[contact.bodyB].invMass : 0.0f;
+        float alpha = contactCompliance / (h * h);
+        if (wA + wB + alpha == 0.0f) return;
+
+        float deltaLambda = -separation / (wA + wB + alpha);
+        contact.normalImpulse += deltaLambda;
+
+        Vector2D correction = contact.normal * deltaLambda;
+        a.position -= correction * wA;
+        if (contact.bodyB >= 0) {
+            bodies[contact.bodyB].position += correction * wB;
+        }
+    }
+
+    // Restitution and dynamic friction on the derived velocities.
+    void solveContactVelocity(ContactConstraint& contact, float h) {
+        if (contact.normalImpulse <= 0.0f) return;
+
+        RigidBody& a = bodies[contact.bodyA];
+        RigidBody* b = contact.bodyB >= 0 ? &bodies[contact.bodyB] : nullptr;
+        float wA = a.invMass;
+        float wB = b ? b->invMass : 0.0f;
+        if (wA + wB == 0.0f) return;
+
+        Vector2D n = contact.normal;
+        Vector2D t = n.perpendicular();
+        float rA = a.radius;
+        float rB = b ? b->radius : 0.0f;
+
+        Vector2D vB = b ? b->velocity : Vector2D(0, 0);
+        float wBAngular = b ? b->angularVelocity : 0.0f;
+        Vector2D relative = vB - a.velocity;
+        float vn = relative.dot(n);
+        float vt = relative.dot(t) - a.angularVelocity * rA - wBAngular * rB;
+
+        Vector2D preB = b ? preSolveVelocities[contact.bodyB] : Vector2D(0, 0);
+        float vnBefore = (preB - preSolveVelocities[contact.bodyA]).dot(n);
+        float e = std::fabs(vn) <= 2.0f * gravity.length() * h ? 0.0f : contact.restitution;
+        float dvn = -vn + std::max(-e * vnBefore, 0.0f);
+
+        float normalForce = contact.normalImpulse / (h * h);
+        float dvt = 0.0f;
+        if (vt != 0.0f) {
+            float maxFriction = contact.friction * normalForce * h;
+            dvt = -vt / std::fabs(vt) * std::min(maxFriction, std::fabs(vt));
+        }
+
+        float pn = dvn / (wA + wB);
+        float tangentMass = wA + wB + rA * rA * a.invInertia + (b ? rB * rB * b->invInertia : 0.0f);
+        float pt = tangentMass > 0.0f ? dvt / tangentMass : 0.0f;
+
+        Vector2D impulse = n * pn + t * pt;
+        a.velocity -= impulse * wA;
+        a.angularVelocity -= pt * rA * a.invInertia;
+        if (b) {
+            b->velocity += impulse * wB;
+            b->angularVelocity -= pt * rB * b->invInertia;
+        }
+    }
+
+    void solveJoint(DistanceJoint& joint, float h) {
+        RigidBody& a = bodies[joint.bodyA];
+        RigidBody& b = bodies[joint.bodyB];
+        Vector2D diff = b.position - a.position;
+        float distance = diff.length();
+        if (distance == 0.0f) return;
+
+        float wSum = a.invMass + b.invMass;
+        float alpha = joint.compliance / (h * h);
+        if (wSum + alpha == 0.0f) return;
+
+        Vector2D n = diff / distance;
+        float c = distance - joint.restLength;
+        float deltaLambda = (-c - alpha * joint.lambda) / (wSum + alpha);
+        joint.lambda += deltaLambda;
+
+        a.position -= n * (deltaLambda * a.invMass);
+        b.position += n * (deltaLambda * b.invMass);
+    }
+
+    void reflectBounds(RigidBody& body) {
+        if (body.position.x - body.radius < 0) {
+            body.position.x = body.radius;
+            body.velocity.x = -body.velocity.x;
+        }
+        if (body.position.x + body.radius > width) {
+            body.position.x = width - body.radius;
+            body.velocity.x = -body.velocity.x;
+        }
+        if (body.position.y - body.radius < 0) {
+            body.position.y = body.radius;
+            body.velocity.y = -body.velocity.y;
+        }
+        if (body.position.y + body.radius > height) {
+            body.position.y = height - body.radius;
+            body.velocity.y = -body.velocity.y;
+        }
+    }
+
+    void clampVelocities() {
+        for (auto& body : bodies) {
+            if (body.velocity.length() > maxVelocity) {
+                body.velocity = body.velocity.normalized() * maxVelocity;
+            }
+        }
+    }
+};
+
+#endif
@@ -1,11 +1,34 @@
 ﻿#include <SFML/Graphics.hpp>
+#include <thread>
+#include <atomic>
+#include <chrono>
 #include "FluidSimulation.h"
+#include "FluidRenderer.h"
+#include "SparseFluidSimulation.h"
+#include "AdaptiveFluidSimulation.h"
+#include "FlipFluidSimulation.h"
+#include "SphFluidSimulation.h"
+#include "PbfFluidSimulation.h"
+#include "LbmFluidSimulation.h"
+#include "ShallowWaterSimulation.h"
+#include "WaveletTurbulence.h"
+#include "CoupledSimulation.h"
+#include "TracerParticles.h"
+#include "ParticleRenderer.h"
 #include "PhysicsSimulation.h"
+#include "RenderSnapshot.h"
+#include "TripleBuffer.h"
 
-enum class VisualizationType {
-    FluidSimulation,
-    PhysicsSimulation
-};
+const int SIM_STEPS_PER_SECOND = 60;
+const int SPARSE_GRID_SIZE = 256;
+const int ADAPTIVE_GRID_SIZE = 256;
+const int FLIP_GRID_SIZE = 128;
+const float SPH_SPACING = 3.0f;
+const float PBF_SPACING = 3.0f;
+const int LBM_GRID_SIZE = 256;
+const int SHALLOW_GRID_SIZE = 1024; // one-meter cells
+const int TURBULENCE_UPSAMPLING = 4;
+const size_t TRACER_COUNT = 1 << 20;
 
 int main() {
     const int width = 64;
@@ -17,12 +40,148 @@ int main() {
         static_cast<unsigned int>(height * cellSize)),
         "Fluid Simulation");
 
-    FluidSimulation fluidSim(width, timestep, 0.0001f);
+    FluidSimulation fluidSim(width, timestep, 0.4f);
     PhysicsSimulation physicsSim;
+    SparseFluidSimulation sparseFluidSim(SPARSE_GRID_SIZE, 6.5f);
+    AdaptiveFluidSimulation adaptiveFluidSim(ADAPTIVE_GRID_SIZE);
+    FlipFluidSimulation flipFluidSim(FLIP_GRID_SIZE);
+    SphFluidSimulation sphFluidSim(width * cellSize, height * cellSize, SPH_SPACING);
+    PbfFluidSimulation pbfFluidSim(width * cellSize, height * cellSize, PBF_SPACING);
+    LbmFluidSimulation lbmFluidSim(LBM_GRID_SIZE, 0.009f);
+    ShallowWaterSimulation shallowWaterSim(SHALLOW_GRID_SIZE, 1.0f);
+    WaveletTurbulence waveletTurbulence(width, TURBULENCE_UPSAMPLING);
+    CoupledSimulation coupledSim(width, cellSize, timestep);
+    TracerParticles tracers;
+    FluidRenderer fluidRenderer;
+    BodyRenderer bodyRenderer;
+    ParticleRenderer particleRenderer;
 
-    VisualizationType currentVisualization = VisualizationType::FluidSimulation;
+    std::atomic<VisualizationType> currentVisualization(VisualizationType::FluidSimulation);
+    std::atomic<bool> toggleStepMode(false);
+    std::atomic<bool> cyclePressureSolver(false);
+    std::atomic<bool> toggleFusedStep(false);
+    std::atomic<bool> running(true);
+    TripleBuffer<RenderSnapshot> snapshots;
 
     fluidSim.setFluidAmount(1.5f);
+    fluidSim.addObstacle(width / 2, height / 2, height / 8);
+    sparseFluidSim.addDensity(SPARSE_GRID_SIZE / 2, SPARSE_GRID_SIZE / 6, SPARSE_GRID_SIZE / 20, 1.0f);
+    adaptiveFluidSim.addObstacle(ADAPTIVE_GRID_SIZE / 2.0f, ADAPTIVE_GRID_SIZE / 2.0f, ADAPTIVE_GRID_SIZE / 8.0f);
+    adaptiveFluidSim.fillRect(ADAPTIVE_GRID_SIZE / 4, ADAPTIVE_GRID_SIZE / 16, 3 * ADAPTIVE_GRID_SIZE / 4, ADAPTIVE_GRID_SIZE / 4, 1.0f);
+    flipFluidSim.addObstacle(FLIP_GRID_SIZE / 2, FLIP_GRID_SIZE / 2, FLIP_GRID_SIZE / 8);
+    flipFluidSim.fillRect(FLIP_GRID_SIZE / 4, FLIP_GRID_SIZE / 16, 3 * FLIP_GRID_SIZE / 4, FLIP_GRID_SIZE / 4, 1.0f);
+    sphFluidSim.addObstacle(width * cellSize / 2, height * cellSize / 2, height * cellSize / 8);
+    sphFluidSim.addBlock(0.0f, height * cellSize * 0.15f, width * cellSize * 0.4f, height * cellSize);
+    pbfFluidSim.addObstacle(width * cellSize / 2, height * cellSize / 2, height * cellSize / 8);
+    pbfFluidSim.addBlock(0.0f, height * cellSize * 0.15f, width * cellSize * 0.4f, height * cellSize);
+    // Slightly off the centerline so the wake starts shedding sooner. The cylinder is 17
+    // cells across and the channel carries the 0.08 inlet speed, so viscosity 0.009 puts
+    // the wake at Re = U * D / nu ~ 150.
+    lbmFluidSim.addObstacle(LBM_GRID_SIZE / 4, LBM_GRID_SIZE / 2 + 2, LBM_GRID_SIZE / 32);
+    shallowWaterSim.addHill(SHALLOW_GRID_SIZE * 0.6f, SHALLOW_GRID_SIZE * 0.5f, SHALLOW_GRID_SIZE * 0.2f, 8.0f);
+    shallowWaterSim.fill(5.0f);
+    shallowWaterSim.addDrop(SHALLOW_GRID_SIZE * 0.2f, SHALLOW_GRID_SIZE * 0.3f, SHALLOW_GRID_SIZE * 0.05f, 2.0f);
+    // Bodies lighter than the pool float, the heavier ones sink.
+    coupledSim.getFluid().fillRect(0, height * 9 / 16, width, height, 1.0f);
+    coupledSim.addBody(Vector2D(width * cellSize * 0.2f, height * cellSize * 0.25f), 4.0f * cellSize, 0.4f);
+    coupledSim.addBody(Vector2D(width * cellSize * 0.45f, height * cellSize * 0.15f), 3.0f * cellSize, 0.7f);
+    coupledSim.addBody(Vector2D(width * cellSize * 0.65f, height * cellSize * 0.3f), 2.5f * cellSize, 0.2f);
+    coupledSim.addBody(Vector2D(width * cellSize * 0.8f, height * cellSize * 0.2f), 3.5f * cellSize, 2.0f);
+
+    const float boundsWidth = static_cast<float>(window.getSize().x);
+    const float boundsHeight = static_cast<float>(window.getSize().y);
+
+    // The simulation runs at its own fixed rate and only ever hands finished
+    // snapshots to the render loop, so present and draw cost never stall a step.
+    std::thread simulationThread([&]() {
+        const auto stepInterval = std::chrono::nanoseconds(1000000000 / SIM_STEPS_PER_SECOND);
+        auto nextStep = std::chrono::steady_clock::now();
+        uint64_t stepIndex = 0;
+        VisualizationType lastVisualization = currentVisualization.load();
+
+        while (running.load(std::memory_order_relaxed)) {
+            if (toggleStepMode.exchange(false)) {
+                physicsSim.toggleStepMode();
+            }
+            if (cyclePressureSolver.exchange(false)) {
+                fluidSim.cyclePressureSolver();
+            }
+            if (toggleFusedStep.exchange(false)) {
+                fluidSim.fusedStep = !fluidSim.fusedStep;
+            }
+
+            VisualizationType visualization = currentVisualization.load();
+            RenderSnapshot& snapshot = snapshots.writeBuffer();
+
+            // The F, T and R views share fluidSim; the fine density restarts from it on the
+            // way in and the tracers are spread out again.
+            if (visualization == VisualizationType::TurbulentFluidSimulation && lastVisualization != visualization) {
+                waveletTurbulence.seed(fluidSim);
+            }
+            if (visualization == VisualizationType::TracerSimulation && lastVisualization != visualization) {
+                tracers.seed(fluidSim, TRACER_COUNT);
+            }
+            lastVisualization = visualization;
+
+            if (visualization == VisualizationType::FluidSimulation) {
+                fluidSim.update(timestep);
+                fluidSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::PhysicsSimulation) {
+                physicsSim.step(boundsWidth, boundsHeight);
+                physicsSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::SparseFluidSimulation) {
+                sparseFluidSim.update(timestep);
+                sparseFluidSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::AdaptiveFluidSimulation) {
+                adaptiveFluidSim.update(timestep);
+                adaptiveFluidSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::FlipFluidSimulation) {
+                flipFluidSim.update(timestep);
+                flipFluidSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::SphFluidSimulation) {
+                sphFluidSim.update(timestep);
+                sphFluidSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::PbfFluidSimulation) {
+                pbfFluidSim.update(timestep);
+                pbfFluidSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::LbmFluidSimulation) {
+                lbmFluidSim.update(timestep);
+                lbmFluidSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::ShallowWaterSimulation) {
+                shallowWaterSim.update(timestep);
+                shallowWaterSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::TurbulentFluidSimulation) {
+                fluidSim.update(timestep);
+                waveletTurbulence.update(fluidSim, timestep);
+                waveletTurbulence.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::CoupledSimulation) {
+                coupledSim.update(timestep);
+                coupledSim.writeSnapshot(snapshot);
+            }
+            else if (visualization == VisualizationType::TracerSimulation) {
+                fluidSim.update(timestep);
+                tracers.update(fluidSim, timestep);
+                tracers.writeSnapshot(snapshot, cellSize);
+            }
+
+            snapshot.visualization = visualization;
+            snapshot.step = ++stepIndex;
+            snapshots.publish();
+
+            nextStep += stepInterval;
+            std::this_thread::sleep_until(nextStep);
+        }
+    });
 
     while (window.isOpen()) {
         sf::Event event;
@@ -37,21 +196,88 @@ int main() {
                 if (event.key.code == sf::Keyboard::P) {
                     currentVisualization = VisualizationType::PhysicsSimulation;
                 }
+                if (event.key.code == sf::Keyboard::G) {
+                    currentVisualization = VisualizationType::SparseFluidSimulation;
+                }
+                if (event.key.code == sf::Keyboard::A) {
+                    currentVisualization = VisualizationType::AdaptiveFluidSimulation;
+                }
+                if (event.key.code == sf::Keyboard::L) {
+                    currentVisualization = VisualizationType::FlipFluidSimulation;
+                }
+                if (event.key.code == sf::Keyboard::H) {
+                    currentVisualization = VisualizationType::SphFluidSimulation;
+                }
+                if (event.key.code == sf::Keyboard::B) {
+                    currentVisualization = VisualizationType::PbfFluidSimulation;
+                }
+                if (event.key.code == sf::Keyboard::M) {
+                    currentVisualization = VisualizationType::LbmFluidSimulation;
+                }
+                if (event.key.code == sf::Keyboard::W) {
+                    currentVisualization = VisualizationType::ShallowWaterSimulation;
+                }
+                if (event.key.code == sf::Keyboard::T) {
+                    currentVisualization = VisualizationType::TurbulentFluidSimulation;
+                }
+                if (event.key.code == sf::Keyboard::C) {
+                    currentVisualization = VisualizationType::CoupledSimulation;
+                }
+                if (event.key.code == sf::Keyboard::R) {
+                    currentVisualization = VisualizationType::TracerSimulation;
+                }
+                if (event.key.code == sf::Keyboard::X) {
+                    toggleStepMode = true;
+                }
+                if (event.key.code == sf::Keyboard::V) {
+                    fluidRenderer.toggleField();
+                }
+                if (event.key.code == sf::Keyboard::S) {
+                    cyclePressureSolver = true;
+                }
+                if (event.key.code == sf::Keyboard::U) {
+                    toggleFusedStep = true;
+                }
             }
         }
 
+        bool fresh = snapshots.update();
+        const RenderSnapshot& snapshot = snapshots.readBuffer();
+
         window.clear(sf::Color::White);
 
-        if (currentVisualization == VisualizationType::FluidSimulation) {
-            fluidSim.update(timestep);
-            fluidSim.render(window);
-        }
-        else if (currentVisualization == VisualizationType::PhysicsSimulation) {
-            physicsSim.update(window);
+        if (snapshot.step > 0) {
+            if (snapshot.visualization == VisualizationType::FluidSimulation ||
+                snapshot.visualization == VisualizationType::SparseFluidSimulation ||
+                snapshot.visualization == VisualizationType::AdaptiveFluidSimulation ||
+                snapshot.visualization == VisualizationType::FlipFluidSimulation ||
+                snapshot.visualization == VisualizationType::LbmFluidSimulation ||
+                snapshot.visualization == VisualizationType::ShallowWaterSimulation ||
+                snapshot.visualization == VisualizationType::TurbulentFluidSimulation) {
+                fluidRenderer.render(window, snapshot, fresh);
+            }
+            else if (snapshot.visualization == VisualizationType::PhysicsSimulation) {
+                physicsSim.draw(window, snapshot, fresh);
+            }
+            else if (snapshot.visualization == VisualizationType::SphFluidSimulation ||
+                snapshot.visualization == VisualizationType::PbfFluidSimulation ||
+                snapshot.visualization == VisualizationType::TracerSimulation) {
+                particleRenderer.render(window, snapshot, fresh);
+            }
+            else if (snapshot.visualization == VisualizationType::CoupledSimulation) {
+                fluidRenderer.render(window, snapshot, fresh);
+                if (fresh) {
+                    bodyRenderer.update(snapshot);
+                }
+                bodyRenderer.draw(window);
+            }
         }
 
         window.display();
     }
 
+    running = false;
+    simulationThread.join();
+
     return 0;
 }